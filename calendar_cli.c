@@ -0,0 +1,981 @@
+// Headless driver for the event store: synthetic data, benchmarks, export.
+// gcc -O2 -o calendar_cli calendar_cli.c calendar_core.c calendar_platform.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "calendar_core.h"
+
+#define BENCH_FILE "calendar_bench.dat"
+#define BENCH_CSV "calendar_bench.csv"
+#define CHECK_CSV "calendar_check.csv"
+#define CHECK_FILE "calendar_check.dat"
+#define BENCH_JOURNAL BENCH_FILE ".jnl"
+#define BENCH_LOOKUPS 10000
+#define BENCH_EDITS 200
+#define BENCH_SERIES 100
+#define BENCH_STATS_READS 1000
+#define MAX_CONFLICTS 1000
+#define BENCH_SLOT_QUERIES 1000
+#define SLOTS_SHOWN 10
+
+static const char *words[] = {
+    "Team", "Project", "Review", "Lunch", "Call", "Sync", "Planning", "Doctor",
+    "Dentist", "Birthday", "Party", "Standup", "Budget", "Design", "Client",
+    "Demo", "Gym", "Interview", "Retro", "Workshop", "Dinner", "Flight"
+};
+static const char *places[] = {
+    "Office", "Home", "Room 4B", "Cafe", "Clinic", "Zoom", "HQ", "Gym", ""
+};
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+#define NUM_PLACES (sizeof(places) / sizeof(places[0]))
+
+static unsigned int rng_state = 12345;
+
+static unsigned int rng_next(void) {
+    rng_state = rng_state * 1103515245u + 12345u;
+    return (rng_state >> 8) & 0xFFFFFF;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Fills the store with n deterministic events spread over ten years
+static void generate_events(int n) {
+    begin_bulk_insert();
+    for (int i = 0; i < n; i++) {
+        char desc[128];
+        int words_used = 2 + rng_next() % 3;
+        desc[0] = '\0';
+        for (int w = 0; w < words_used; w++) {
+            if (w) strcat(desc, " ");
+            strcat(desc, words[rng_next() % NUM_WORDS]);
+        }
+
+        Date d;
+        d.year = 2020 + rng_next() % 10;
+        d.month = 1 + rng_next() % 12;
+        d.day = 1 + rng_next() % days_in_month(d.month, d.year);
+
+        int all_day = rng_next() % 10 == 0;
+        Time start = { 7 + rng_next() % 11, (rng_next() % 4) * 15 };
+        Time end = { start.hour + 1 + rng_next() % 3, start.minute };
+
+        Event *e = add_event(d, start, end, desc, places[rng_next() % NUM_PLACES],
+                             (Priority)(rng_next() % 4), (Category)(rng_next() % 8),
+                             all_day, rng_next() % 3 == 0 ? 15 : 0);
+        if (!e) break;
+    }
+    end_bulk_insert();
+}
+
+static void reset_store(void) {
+    free_events();
+    next_id = 1;
+}
+
+// Monday to Friday, 09:00-18:00; reminders do not make anyone busy
+static void office_hours_query(SlotQuery *q, int minutes) {
+    memset(q, 0, sizeof(*q));
+    q->day_start.hour = 9;
+    q->day_end.hour = 18;
+    q->minutes = minutes;
+    q->weekdays = 0x1F;
+    q->ignore_categories = 1u << CAT_REMINDER;
+}
+
+// FNV-1a over a whole file; 0 if it cannot be read
+static unsigned long long file_digest(const char *path) {
+    unsigned long long h = 14695981039346656037ull;
+    unsigned char buf[65536];
+    size_t got;
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    while ((got = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        for (size_t i = 0; i < got; i++) h = (h ^ buf[i]) * 1099511628211ull;
+    }
+    fclose(fp);
+    return h;
+}
+
+// Steps that check results as well as time them count failures here;
+// "bench" then exits with status 1
+static int bench_failures = 0;
+
+static void run_bench(int n) {
+    double t0, t1, t2;
+    int found = 0, matched = 0;
+
+    reset_store();
+    rng_state = 12345;
+
+    t0 = now_ms();
+    generate_events(n);
+    t1 = now_ms();
+    printf("%9d  generate %10.2f ms\n", n, t1 - t0);
+
+    t0 = now_ms();
+    save_events_to(BENCH_FILE);
+    t1 = now_ms();
+    printf("%9d  save     %10.2f ms\n", n, t1 - t0);
+
+    reset_store();
+    t0 = now_ms();
+    load_events_from(BENCH_FILE);
+    t1 = now_ms();
+    printf("%9d  load     %10.2f ms  (%d events)\n", n, t1 - t0, count_events());
+
+    t0 = now_ms();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        if (find_event_by_id(1 + rng_next() % n)) found++;
+    }
+    t1 = now_ms();
+    printf("%9d  lookup   %10.2f ms  (%d x, %d found)\n", n, t1 - t0, BENCH_LOOKUPS, found);
+
+    EventFilter filter = { NULL, "review", CAT_MEETING, -1, NULL };
+    t0 = now_ms();
+    for (int pos = 0; pos < event_table_size(); pos++) {
+        if (event_matches(event_at(pos), &filter)) matched++;
+    }
+    t1 = now_ms();
+    printf("%9d  filter   %10.2f ms  (%d matches)\n", n, t1 - t0, matched);
+
+    // Column filter: a year of high-priority meetings selected into a
+    // bitmap from the filter columns, against event_matches on every event
+    Date year_from = { 1, 1, 2024 }, year_to = { 31, 12, 2024 };
+    EventFilter meetings = { &year_from, NULL, CAT_MEETING, PRIORITY_HIGH, &year_to };
+    int size = event_table_size(), selected = 0, scanned_meetings = 0;
+    unsigned *selection = malloc(((size_t)size + 31) / 32 * sizeof(unsigned) + 1);
+    t0 = now_ms();
+    if (selection) select_events(&meetings, 0, size, selection);
+    t1 = now_ms();
+    if (selection) selected = select_events(&meetings, 0, size, selection);
+    t2 = now_ms();
+    for (int pos = 0; pos < size; pos++) {
+        if (event_matches(event_at(pos), &meetings)) scanned_meetings++;
+    }
+    printf("%9d  select   %10.2f ms  (columns, then %.2f ms for %d matches; %.2f ms to scan %d)\n",
+           n, t1 - t0, t2 - t1, selected, now_ms() - t2, scanned_meetings);
+    free(selection);
+
+    // Indexed search against a full scan for the same queries
+    static const char *queries[] = { "review", "dentist", "room 4b", "xyz" };
+    int hits = 0, scanned = 0;
+    const int *ids;
+    t0 = now_ms();
+    search_events("warm up", &ids);
+    t1 = now_ms();
+    printf("%9d  index    %10.2f ms\n", n, t1 - t0);
+    t0 = now_ms();
+    for (int q = 0; q < 4; q++) hits += search_events(queries[q], &ids);
+    t1 = now_ms();
+    for (int q = 0; q < 4; q++) {
+        EventFilter text = { NULL, queries[q], -1, -1, NULL };
+        for (int pos = 0; pos < event_table_size(); pos++) {
+            if (event_matches(event_at(pos), &text)) scanned++;
+        }
+    }
+    printf("%9d  search   %10.2f ms  (4 queries, %d hits, %.2f ms to scan)\n",
+           n, t1 - t0, hits, now_ms() - t1);
+
+    // Scan kernel: copying and lowercasing both fields for strstr, as the
+    // list used to, against the in-place matcher on the same queries
+    int copied_hits = 0, kernel_hits = 0;
+    t0 = now_ms();
+    for (int q = 0; q < 4; q++) {
+        char query[64], desc[256], loc[256];
+        snprintf(query, sizeof(query), "%s", queries[q]);
+        str_to_lower(query);
+        for (int pos = 0; pos < event_table_size(); pos++) {
+            Event *e = event_at(pos);
+            if (e->deleted) continue;
+            snprintf(desc, sizeof(desc), "%s", e->description);
+            snprintf(loc, sizeof(loc), "%s", e->location);
+            if (strstr(str_to_lower(desc), query) || strstr(str_to_lower(loc), query)) copied_hits++;
+        }
+    }
+    t1 = now_ms();
+    for (int q = 0; q < 4; q++) {
+        for (int pos = 0; pos < event_table_size(); pos++) {
+            Event *e = event_at(pos);
+            if (e->deleted) continue;
+            if (text_contains_nocase(e->description, queries[q]) ||
+                text_contains_nocase(e->location, queries[q])) kernel_hits++;
+        }
+    }
+    printf("%9d  match    %10.2f ms  (copy+lower+strstr, %d hits; %s in place %.2f ms, %d hits)%s\n",
+           n, t1 - t0, copied_hits, text_match_kernel(), now_ms() - t1, kernel_hits,
+           copied_hits == kernel_hits ? "" : "  MISMATCH");
+    if (copied_hits != kernel_hits) bench_failures++;
+
+    // Type-ahead: each longer prefix narrows the last result set, so it
+    // filters those rows instead of the store
+    static const char *typed[] = { "r", "re", "rev", "revi", "revie", "review" };
+    int *rows = malloc((size_t)count_events() * sizeof(int) + 1);
+    int row_count = 0;
+    EventFilter last = { NULL, typed[0], -1, -1, NULL };
+    t0 = now_ms();
+    for (int pos = 0; rows && pos < event_table_size(); pos++) {
+        if (event_matches(event_at(pos), &last)) rows[row_count++] = event_at(pos)->id;
+    }
+    for (int k = 1; rows && k < 6; k++) {
+        EventFilter next = { NULL, typed[k], -1, -1, NULL };
+        if (!filter_narrows(&next, &last)) break;
+        int kept = 0;
+        for (int i = 0; i < row_count; i++) {
+            if (event_matches(find_event_by_id(rows[i]), &next)) rows[kept++] = rows[i];
+        }
+        row_count = kept;
+        last = next;
+    }
+    t1 = now_ms();
+    free(rows);
+    printf("%9d  typeahead%10.2f ms  (6 keystrokes, %d rows)\n", n, t1 - t0, row_count);
+
+    // Month calendar scrolling across all ten years: one mask per month
+    unsigned busy = 0;
+    t0 = now_ms();
+    month_busy_days(2020, 1);
+    t1 = now_ms();
+    for (int y = 2020; y < 2030; y++) {
+        for (int m = 1; m <= 12; m++) {
+            for (unsigned mask = month_busy_days(y, m); mask; mask &= mask - 1) busy++;
+        }
+    }
+    printf("%9d  days     %10.2f ms  (index, then 120 months in %.3f ms, %u busy days)\n",
+           n, t1 - t0, now_ms() - t1, busy);
+
+    // Dashboard: counters built once, then every read skips the events
+    EventStats stats;
+    t0 = now_ms();
+    get_event_stats(&stats);
+    t1 = now_ms();
+    for (int i = 0; i < BENCH_STATS_READS; i++) get_event_stats(&stats);
+    printf("%9d  stats    %10.2f ms  (counters, then %d reads in %.2f ms, busiest day %d events)\n",
+           n, t1 - t0, BENCH_STATS_READS, now_ms() - t1,
+           stats.busiest_count ? stats.busiest[0].events : 0);
+
+    // Month views: a binary-searched slice per month against a scan that
+    // compares every event's date with the range
+    int in_range = 0, scan_range = 0;
+    t0 = now_ms();
+    for (int y = 2020; y < 2030; y++) {
+        for (int m = 1; m <= 12; m++) {
+            Date from = { 1, m, y }, to = { days_in_month(m, y), m, y };
+            int first, count = event_range(from, to, &first);
+            for (int pos = first; pos < first + count; pos++) {
+                if (!event_at(pos)->deleted) in_range++;
+            }
+        }
+    }
+    t1 = now_ms();
+    for (int y = 2020; y < 2030; y++) {
+        for (int m = 1; m <= 12; m++) {
+            Date from = { 1, m, y }, to = { days_in_month(m, y), m, y };
+            EventFilter month = { &from, NULL, -1, -1, &to };
+            for (int pos = 0; pos < event_table_size(); pos++) {
+                if (event_matches(event_at(pos), &month)) scan_range++;
+            }
+        }
+    }
+    printf("%9d  range    %10.2f ms  (120 months, %d events, %.2f ms to scan %d)\n",
+           n, t1 - t0, in_range, now_ms() - t1, scan_range);
+
+    // Recurrence: daily series over the same ten years are one record each;
+    // month masks and month views expand only the months they look at
+    int series = 0, occurrences = 0;
+    busy = 0;
+    Recurrence daily = { REPEAT_DAILY, 1, 0, { 31, 12, 2029 }, 0, NULL, 0 };
+    for (int id = 1; id <= n && series < BENCH_SERIES; id++) {
+        if (find_event_by_id(id) && set_event_repeat(id, &daily)) series++;
+    }
+    t0 = now_ms();
+    for (int y = 2020; y < 2030; y++) {
+        for (int m = 1; m <= 12; m++) {
+            for (unsigned mask = month_busy_days(y, m); mask; mask &= mask - 1) busy++;
+        }
+    }
+    t1 = now_ms();
+    for (int y = 2020; y < 2030; y++) {
+        for (int m = 1; m <= 12; m++) {
+            Date from = { 1, m, y }, to = { days_in_month(m, y), m, y };
+            EventFilter month = { &from, NULL, -1, -1, &to };
+            for (int i = 0; i < series_count(); i++) {
+                const Event *e = series_at(i);
+                Date d;
+                if (!event_matches(e, &month)) continue;
+                for (next_occurrence(e, from, &d); compare_dates(d, to) <= 0; occurrences++) {
+                    Date after = days_to_date(date_to_days(d) + 1);
+                    if (!next_occurrence(e, after, &d)) break;
+                }
+            }
+        }
+    }
+    t2 = now_ms();
+    printf("%9d  repeat   %10.2f ms  (%d series, 120 months %u busy days, "
+           "%d occurrences expanded in %.2f ms)\n",
+           n, t1 - t0, series, busy, occurrences, t2 - t1);
+    for (int i = series_count() - 1; i >= 0; i--) set_event_repeat(series_at(i)->id, NULL);
+
+    // Reminder queue: heapify, reschedule through edits, then let two
+    // simulated years pass; each step only touches the heap root
+    int queued, fired = 0, batch[256], got;
+    long long due = 0;
+    t0 = now_ms();
+    queued = pending_reminders();
+    t1 = now_ms();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        Event *e = find_event_by_id(1 + rng_next() % n);
+        if (!e) continue;
+        update_event(e->id, e->date, e->start_time, e->end_time, e->description, e->location,
+                     e->priority, e->category, e->is_all_day, 5 + rng_next() % 120);
+    }
+    t2 = now_ms();
+    Date from = { 1, 1, 2020 }, until = { 1, 1, 2022 };
+    for (long long now = (long long)date_to_days(from) * 1440;
+         now < (long long)date_to_days(until) * 1440; now += 5) {
+        if (!next_reminder_due(&due) || due > now) continue;
+        while ((got = pop_due_reminders(now, batch, 256)) > 0) fired += got;
+    }
+    printf("%9d  remind   %10.2f ms  (%d queued, %d edits in %.2f ms, "
+           "%d fired over 2 years in %.2f ms, %d left)\n",
+           n, t1 - t0, queued, BENCH_LOOKUPS, t2 - t1, fired, now_ms() - t2, pending_reminders());
+
+    // Conflict checks as on save: the interval tree against comparing the
+    // times of every event on that day, then a week's conflict report
+    int overlaps = 0, day_overlaps = 0, ids_found[16];
+    unsigned saved_rng = rng_state;
+    t0 = now_ms();
+    find_overlaps(from, (Time){ 9, 0 }, (Time){ 10, 0 }, 0, 0, ids_found, 16);
+    t1 = now_ms();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        Date d = { 1 + rng_next() % 28, 1 + rng_next() % 12, 2020 + rng_next() % 10 };
+        Time start = { 8 + rng_next() % 9, 0 }, end = { start.hour + 1, 30 };
+        overlaps += find_overlaps(d, start, end, 0, 0, ids_found, 16);
+    }
+    t2 = now_ms();
+    rng_state = saved_rng;
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        Date d = { 1 + rng_next() % 28, 1 + rng_next() % 12, 2020 + rng_next() % 10 };
+        Time start = { 8 + rng_next() % 9, 0 }, end = { start.hour + 1, 30 };
+        int lo = start.hour * 60 + start.minute, hi = end.hour * 60 + end.minute;
+        int first, count = event_range(d, d, &first);
+        for (int pos = first; pos < first + count; pos++) {
+            Event *e = event_at(pos);
+            if (!e->deleted && (e->is_all_day || (e->start_time.hour * 60 + e->start_time.minute < hi &&
+                                                  e->end_time.hour * 60 + e->end_time.minute > lo))) {
+                day_overlaps++;
+            }
+        }
+    }
+    double t3 = now_ms();
+    EventConflict *conflicts = malloc(MAX_CONFLICTS * sizeof(EventConflict));
+    Date week_from = { 4, 3, 2024 }, week_to = { 10, 3, 2024 };
+    int reported = conflicts ? find_conflicts(week_from, week_to, conflicts, MAX_CONFLICTS) : 0;
+    printf("%9d  overlap  %10.2f ms  (tree, then %d checks in %.2f ms, %d overlaps; %.2f ms by day scan, %d; "
+           "week report %.2f ms, %d conflicts)\n",
+           n, t1 - t0, BENCH_LOOKUPS, t2 - t1, overlaps, t3 - t2, day_overlaps, now_ms() - t3, reported);
+    free(conflicts);
+
+    // "First free 45 minutes in office hours over the next two weeks",
+    // reminders not counting as busy
+    FreeSlot slots[3];
+    SlotQuery q;
+    office_hours_query(&q, 45);
+    int slot_queries = 0, slots_found = 0;
+    t0 = now_ms();
+    for (int i = 0; i < BENCH_SLOT_QUERIES; i++) {
+        q.from = (Date){ 1 + rng_next() % 28, 1 + rng_next() % 12, 2020 + rng_next() % 10 };
+        q.to = days_to_date(date_to_days(q.from) + 13);
+        int found = find_free_slots(&q, slots, 3);
+        if (found < 0) continue;
+        slots_found += found;
+        slot_queries++;
+    }
+    t1 = now_ms();
+    printf("%9d  slots    %10.2f ms  (%d two-week queries, %.3f ms each, %d slots)\n",
+           n, t1 - t0, slot_queries, slot_queries ? (t1 - t0) / slot_queries : 0.0, slots_found);
+
+    // Build every column's sort permutation, then walk one backwards;
+    // the edits below keep all of them current
+    t0 = now_ms();
+    for (int col = 0; col < SORT_COLUMNS; col++) sorted_event_count((SortColumn)col);
+    t1 = now_ms();
+    printf("%9d  sort     %10.2f ms  (%d columns)\n", n, t1 - t0, SORT_COLUMNS);
+
+    int walked = 0;
+    t0 = now_ms();
+    for (int i = sorted_event_count(SORT_DESCRIPTION) - 1; i >= 0; i--) {
+        if (sorted_event_at(SORT_DESCRIPTION, i)->priority == PRIORITY_CRITICAL) walked++;
+    }
+    t1 = now_ms();
+    printf("%9d  reverse  %10.2f ms  (%d critical)\n", n, t1 - t0, walked);
+
+    // Journaled edits: each one is a small flushed append, whatever n is
+    int edits = 0;
+    open_journal(BENCH_FILE);
+    t0 = now_ms();
+    for (int i = 0; i < BENCH_EDITS; i++) {
+        Event *e = find_event_by_id(1 + rng_next() % n);
+        if (!e) continue;
+        e = update_event(e->id, e->date, e->start_time, e->end_time, "Edited in bench",
+                         e->location, e->priority, e->category, e->is_all_day, e->reminder_minutes);
+        if (e && journal_put(e)) edits++;
+    }
+    t1 = now_ms();
+    close_journal();
+    printf("%9d  edit     %10.2f ms  (%d journaled, %.3f ms each)\n",
+           n, t1 - t0, edits, edits ? (t1 - t0) / edits : 0.0);
+
+    reset_store();
+    t0 = now_ms();
+    load_events_from(BENCH_FILE);
+    int replayed = open_journal(BENCH_FILE);
+    t1 = now_ms();
+    printf("%9d  replay   %10.2f ms  (%d entries)\n", n, t1 - t0, replayed);
+
+    t0 = now_ms();
+    checkpoint_journal();
+    t1 = now_ms();
+    printf("%9d  ckpoint  %10.2f ms\n", n, t1 - t0);
+
+    // Same edits through the worker: the caller only pays for encoding
+    start_persist_worker(NULL, NULL);
+    t0 = now_ms();
+    for (int i = 0; i < BENCH_EDITS; i++) {
+        Event *e = find_event_by_id(1 + rng_next() % n);
+        if (e) journal_put(e);
+    }
+    checkpoint_journal();
+    t1 = now_ms();
+    stop_persist_worker();
+    t2 = now_ms();
+    close_journal();
+    printf("%9d  async    %10.2f ms  (%d edits + checkpoint queued, %.2f ms until written)\n",
+           n, t1 - t0, BENCH_EDITS, t2 - t0);
+
+    // One formatting thread, then one per processor
+    t0 = now_ms();
+    export_events_to_csv(BENCH_CSV, NULL, 0, 1);
+    t1 = now_ms();
+    export_to_csv(BENCH_CSV);
+    t2 = now_ms();
+    printf("%9d  export   %10.2f ms  (%.2f ms threaded)\n", n, t1 - t0, t2 - t1);
+
+    // Scaling of the parallel scans: text filter over the whole table,
+    // first build of the statistics counters, and export. Every thread
+    // count must give the bitmap, figures and file bytes of the first.
+    EventFilter reviews = { NULL, "review", -1, -1, NULL };
+    size_t bits_size = ((size_t)event_table_size() + 31) / 32 * sizeof(unsigned);
+    unsigned *scale_bits = malloc(bits_size + 1), *base_bits = malloc(bits_size + 1);
+    EventStats base_stats;
+    unsigned long long base_digest = 0;
+    double base = 0;
+    for (int threads = 1; scale_bits && base_bits && threads <= SCAN_MAX_THREADS; threads *= 2) {
+        set_scan_threads(threads);
+        select_events(&reviews, 0, event_table_size(), scale_bits);
+        t0 = now_ms();
+        int hits = select_events(&reviews, 0, event_table_size(), scale_bits);
+        t1 = now_ms();
+        // An empty bulk insert drops the counters; the day index is rebuilt
+        // first so only the counters are timed
+        begin_bulk_insert();
+        end_bulk_insert();
+        month_busy_days(2020, 1);
+        t2 = now_ms();
+        get_event_stats(&stats);
+        double t3 = now_ms();
+        export_to_csv(BENCH_CSV);
+        double t4 = now_ms();
+        double total = (t1 - t0) + (t4 - t2);
+        unsigned long long digest = file_digest(BENCH_CSV);
+        if (threads == 1) {
+            base = total;
+            memcpy(base_bits, scale_bits, bits_size);
+            base_stats = stats;
+            base_digest = digest;
+        }
+        int same = memcmp(scale_bits, base_bits, bits_size) == 0 &&
+                   memcmp(&stats, &base_stats, sizeof(stats)) == 0 && digest && digest == base_digest;
+        printf("%9d  scale %2d %10.2f ms  (filter %.2f ms %d hits, stats %.2f ms, export %.2f ms; %.2fx)%s\n",
+               n, threads, total, t1 - t0, hits, t3 - t2, t4 - t3, total > 0 ? base / total : 0.0,
+               same ? "" : "  MISMATCH with 1 thread");
+        if (!same) bench_failures++;
+    }
+    free(scale_bits);
+    free(base_bits);
+    set_scan_threads(0);
+    stop_scan_workers();
+
+    // Churn: drop every fourth event, then add the same number back
+    StoreStats st;
+    int churn = 0;
+    t0 = now_ms();
+    for (int id = 1; id <= n; id += 4) {
+        delete_event(id);
+        churn++;
+    }
+    generate_events(churn);
+    t1 = now_ms();
+    get_store_stats(&st);
+    printf("%9d  churn    %10.2f ms  (%d live, %d dead, %d slots, %d compactions)\n",
+           n, t1 - t0, st.live, st.dead, st.slots, st.compactions);
+
+    t0 = now_ms();
+    reset_store();
+    t1 = now_ms();
+    printf("%9d  teardown %10.2f ms  (%d chunks, %zu KB used, %zu KB wasted)\n",
+           n, t1 - t0, st.arena_chunks, st.arena_bytes_used / 1024, st.arena_bytes_wasted / 1024);
+
+    // Read the export back into the empty store, one chunk at a time
+    ImportResult imported;
+    t0 = now_ms();
+    import_from_csv(BENCH_CSV, &imported, NULL, NULL);
+    t1 = now_ms();
+    printf("%9d  import   %10.2f ms  (%d rows, %d rejected, %.0f rows/s)\n",
+           n, t1 - t0, imported.imported, imported.rejected,
+           t1 > t0 ? imported.lines / ((t1 - t0) / 1000.0) : 0.0);
+    reset_store();
+    remove(BENCH_FILE);
+    remove(BENCH_JOURNAL);
+    remove(BENCH_CSV);
+}
+
+static void print_conflicts(Date from, Date to) {
+    EventConflict *conflicts = malloc(MAX_CONFLICTS * sizeof(EventConflict));
+    int n = conflicts ? find_conflicts(from, to, conflicts, MAX_CONFLICTS) : -1;
+    if (n < 0) {
+        fprintf(stderr, "Out of memory\n");
+        free(conflicts);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        const EventConflict *c = &conflicts[i];
+        const Event *a = find_event_by_id(c->first), *b = find_event_by_id(c->second);
+        printf("%02d/%02d/%d %02d:%02d %4d min  #%d %s  <>  #%d %s\n",
+               c->date.day, c->date.month, c->date.year, c->start.hour, c->start.minute,
+               c->minutes, c->first, a ? a->description : "", c->second, b ? b->description : "");
+    }
+    printf("%d conflicts%s\n", n, n == MAX_CONFLICTS ? " (first shown only)" : "");
+    free(conflicts);
+}
+
+static void print_free_slots(const SlotQuery *q) {
+    FreeSlot slots[SLOTS_SHOWN];
+    int n = find_free_slots(q, slots, SLOTS_SHOWN);
+    if (n < 0) {
+        fprintf(stderr, "Invalid query or out of memory\n");
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        const FreeSlot *s = &slots[i];
+        int minutes = (s->end.hour - s->start.hour) * 60 + s->end.minute - s->start.minute;
+        printf("%02d/%02d/%d %02d:%02d-%02d:%02d %4d min\n", s->date.day, s->date.month, s->date.year,
+               s->start.hour, s->start.minute, s->end.hour, s->end.minute, minutes);
+    }
+    printf("%d free slots%s\n", n, n == SLOTS_SHOWN ? " (first shown only)" : "");
+}
+
+static void print_stats(void) {
+    EventStats st;
+    get_event_stats(&st);
+    printf("events %d, all-day %d, with reminder %d, repeating %d\n",
+           st.total, st.all_day, st.with_reminder, st.repeating);
+    for (int p = PRIORITY_CRITICAL; p >= PRIORITY_LOW; p--) {
+        printf("  %-12s %d\n", priority_to_string((Priority)p), st.priorities[p]);
+    }
+    for (int c = CAT_WORK; c <= CAT_OTHER; c++) {
+        printf("  %-12s %d (%.1f h)\n", category_to_string((Category)c), st.categories[c],
+               st.category_minutes[c] / 60.0);
+    }
+    printf("busiest days:\n");
+    for (int i = 0; i < st.busiest_count; i++) {
+        printf("  %02d/%02d/%d %d\n", st.busiest[i].date.day, st.busiest[i].date.month,
+               st.busiest[i].date.year, st.busiest[i].events);
+    }
+
+    // Months from the first event to the last, skipping empty ones
+    int first = 0, last = event_table_size() - 1;
+    while (first <= last && event_at(first)->deleted) first++;
+    while (last >= first && event_at(last)->deleted) last--;
+    if (first > last) return;
+    Date from = event_at(first)->date, to = event_at(last)->date;
+    int months = (to.year - from.year) * 12 + to.month - from.month + 1;
+    int *counts = malloc((size_t)months * sizeof(int));
+    if (!counts) return;
+    month_histogram(from.year, from.month, months, counts);
+    printf("by month:\n");
+    for (int i = 0; i < months; i++) {
+        int m = from.month - 1 + i;
+        if (counts[i]) printf("  %d-%02d %d\n", from.year + m / 12, m % 12 + 1, counts[i]);
+    }
+    free(counts);
+}
+
+static void print_bad_line(long line, const char *reason, void *user) {
+    fprintf(stderr, "%s:%ld: %s\n", (const char*)user, line, reason);
+}
+
+// Self-checks run by "check": each prints what failed and returns the
+// number of failures
+
+// An export written before quotes were escaped. The stray quote in the
+// first description must not swallow the rows after it, and a quoted
+// line break stays inside its field.
+static int check_legacy_quotes(void) {
+    static const char fixture[] =
+        "ID,Date,Time,Description,Location,Priority,Category,Reminder\r\n"
+        "1,15/12/2025,09:00-10:00,\"5\" screen\",\"Office\",High,Work,15 min\r\n"
+        "2,16/12/2025,All Day,\"Two\r\nlines\",\"Home\",Low,Personal,0 min\r\n"
+        "3,17/12/2025,11:00-12:00,\"Say \"\"hi\"\"\",\"\",Medium,Meeting,0 min\r\n";
+    static const char *expected[] = { "5\" screen", "Two\r\nlines", "Say \"hi\"" };
+    ImportResult res;
+    int failures = 0;
+    FILE *fp = fopen(CHECK_CSV, "wb");
+    if (!fp || fwrite(fixture, 1, sizeof(fixture) - 1, fp) != sizeof(fixture) - 1) {
+        if (fp) fclose(fp);
+        printf("FAIL legacy quotes: cannot write %s\n", CHECK_CSV);
+        return 1;
+    }
+    fclose(fp);
+    reset_store();
+    if (!import_from_csv(CHECK_CSV, &res, NULL, NULL) || res.imported != 3 || res.rejected != 0) {
+        printf("FAIL legacy quotes: imported %d, rejected %d of 3 rows\n", res.imported, res.rejected);
+        failures++;
+    }
+    for (int id = 1; id <= 3 && !failures; id++) {
+        const Event *e = find_event_by_id(id);
+        if (!e || strcmp(e->description, expected[id - 1]) != 0) {
+            printf("FAIL legacy quotes: row %d reads back as [%s]\n", id, e ? e->description : "");
+            failures++;
+        }
+    }
+    reset_store();
+    remove(CHECK_CSV);
+    return failures;
+}
+
+// Rows with fewer fields than the time column are rejected by count
+// before any missing field is read
+static void count_short_rows(long line, const char *reason, void *user) {
+    (void)line;
+    if (strcmp(reason, "expected 8 fields") == 0) (*(int*)user)++;
+}
+
+static int check_short_rows(void) {
+    static const char fixture[] =
+        "foo\r\n"
+        "1,01/01/2025\r\n"
+        "2,02/01/2025,All Day,\"Kept\",\"\",Low,Other,0 min\r\n";
+    ImportResult res;
+    int short_rows = 0, failures = 0;
+    FILE *fp = fopen(CHECK_CSV, "wb");
+    if (!fp || fwrite(fixture, 1, sizeof(fixture) - 1, fp) != sizeof(fixture) - 1) {
+        if (fp) fclose(fp);
+        printf("FAIL short rows: cannot write %s\n", CHECK_CSV);
+        return 1;
+    }
+    fclose(fp);
+    reset_store();
+    if (!import_from_csv(CHECK_CSV, &res, count_short_rows, &short_rows) ||
+        res.imported != 1 || res.rejected != 2 || short_rows != 2) {
+        printf("FAIL short rows: imported %d, rejected %d, %d as \"expected 8 fields\"\n",
+               res.imported, res.rejected, short_rows);
+        failures++;
+    }
+    reset_store();
+    remove(CHECK_CSV);
+    return failures;
+}
+
+// A v4 record whose date cannot exist (day 200) is dropped on load
+// instead of being filed under a different day than it shows
+static int check_bad_record_date(void) {
+    Date d = { 15, 3, 2024 };
+    Time t = { 9, 0 }, u = { 10, 0 };
+    unsigned char image[4096];
+    int failures = 0;
+    reset_store();
+    add_event(d, t, u, "Bad", "", PRIORITY_LOW, CAT_WORK, 0, 0);
+    d.day = 16;
+    add_event(d, t, u, "Good", "", PRIORITY_LOW, CAT_WORK, 0, 0);
+    save_events_to(CHECK_FILE);
+    reset_store();
+
+    // Day byte of the first record: offset from the records section entry
+    FILE *fp = fopen(CHECK_FILE, "r+b");
+    size_t size = fp ? fread(image, 1, sizeof(image), fp) : 0;
+    size_t records = 0;
+    for (size_t sec = 24; sec + 24 <= size && sec < 24 + 24 * (size_t)(image[6] | image[7] << 8); sec += 24) {
+        if (image[sec] == 1) records = image[sec + 8] | image[sec + 9] << 8 | (size_t)image[sec + 10] << 16;
+    }
+    if (!records || records + 32 > size) {
+        printf("FAIL bad record date: cannot patch %s\n", CHECK_FILE);
+        if (fp) fclose(fp);
+        remove(CHECK_FILE);
+        return 1;
+    }
+    fseek(fp, (long)(records + 7), SEEK_SET);
+    fputc(200, fp);
+    fclose(fp);
+
+    if (!load_events_from(CHECK_FILE) || count_events() != 1 || find_event_by_id(1) || !find_event_by_id(2)) {
+        printf("FAIL bad record date: %d events loaded, expected only the valid one\n", count_events());
+        failures++;
+    }
+    reset_store();
+    remove(CHECK_FILE);
+    return failures;
+}
+
+// A proposed weekly series clashes with a one-off event on its fourth
+// week only; one past the horizon or the rule's count is not reported
+static int check_series_overlaps(void) {
+    Date first = { 1, 1, 2025 }, clash = { 22, 1, 2025 }, late = { 8, 1, 2026 };
+    Time t = { 10, 0 }, u = { 11, 0 }, start = { 10, 30 };
+    Recurrence weekly = { REPEAT_WEEKLY, 1, 0, { 0, 0, 0 }, 0, NULL, 0 };
+    int ids[4], failures = 0;
+    reset_store();
+    add_event(clash, t, u, "Clash", "", PRIORITY_LOW, CAT_WORK, 0, 0);
+    add_event(late, t, u, "Late", "", PRIORITY_LOW, CAT_WORK, 0, 0);
+
+    int once = find_series_overlaps(first, start, u, 0, NULL, 366, 0, ids, 4);
+    int series = find_series_overlaps(first, start, u, 0, &weekly, 366, 0, ids, 4);
+    if (once != 0 || series != 1 || ids[0] != 1) {
+        printf("FAIL series overlaps: %d once, %d weekly (first id %d), expected 0 and 1 (id 1)\n",
+               once, series, series > 0 ? ids[0] : 0);
+        failures++;
+    }
+    weekly.count = 3;
+    if ((series = find_series_overlaps(first, start, u, 0, &weekly, 366, 0, ids, 4)) != 0) {
+        printf("FAIL series overlaps: %d found for three weeks, expected 0\n", series);
+        failures++;
+    }
+    weekly.count = 0;
+    if ((series = find_series_overlaps(first, start, u, 0, &weekly, 366, 1, ids, 4)) != 0) {
+        printf("FAIL series overlaps: %d found excluding the clash, expected 0\n", series);
+        failures++;
+    }
+    reset_store();
+    return failures;
+}
+
+// Every substring kernel against a plain byte loop. Text lengths run past
+// the 16- and 32-byte steps so matches land in the vector loop, the
+// 16-byte step and the scalar tail. The alphabet has letters in both
+// cases, '@' / '`' and '[' / '{' (equal once bit 0x20 is set, unequal
+// when folded) and bytes from 0x80 up.
+#define CHECK_MATCH_MAX_TEXT 80
+#define CHECK_MATCH_TRIALS 40
+
+static int reference_contains(const unsigned char *t, size_t n, const unsigned char *q, size_t m) {
+    for (size_t i = 0; i + m <= n; i++) {
+        size_t k = 0;
+        while (k < m && tolower(t[i + k]) == tolower(q[k])) k++;
+        if (k == m) return 1;
+    }
+    return m == 0;
+}
+
+static int check_match_kernels(void) {
+    static const char alphabet[] = "aAbBzZ@`[{^~ 0\x80\xc4\xe4\xff";
+    static const char *kernels[] = { "scalar", "sse2", "avx2" };
+    unsigned char text[CHECK_MATCH_MAX_TEXT + 1], query[CHECK_MATCH_MAX_TEXT + 1];
+    unsigned int saved_rng = rng_state;
+    int failures = 0;
+    rng_state = 777;
+    for (int k = 0; k < 3; k++) {
+        if (!use_text_match_kernel(kernels[k]) || strcmp(text_match_kernel(), kernels[k]) != 0) {
+            printf("skip %s kernel: not supported by this CPU\n", kernels[k]);
+            continue;
+        }
+        int bad = 0;
+        for (int n = 1; n <= CHECK_MATCH_MAX_TEXT && !bad; n++) {
+            for (int trial = 0; trial < CHECK_MATCH_TRIALS && !bad; trial++) {
+                for (int i = 0; i < n; i++) text[i] = (unsigned char)alphabet[rng_next() % (sizeof(alphabet) - 1)];
+                text[n] = '\0';
+                // Short queries most of the time, often copied from the
+                // text with flipped case, half of those at the very end
+                int m = trial % 4 == 0 ? 1 : 1 + (int)(rng_next() % (n < 8 ? n : 8));
+                if (trial % 8 == 7) m = 1 + (int)(rng_next() % n);
+                int at = trial % 2 ? n - m : (int)(rng_next() % (n - m + 1));
+                for (int i = 0; i < m; i++) {
+                    unsigned char c = trial % 3 ? text[at + i]
+                                                : (unsigned char)alphabet[rng_next() % (sizeof(alphabet) - 1)];
+                    query[i] = isalpha(c) && rng_next() % 2 ? (unsigned char)(c ^ 0x20) : c;
+                }
+                query[m] = '\0';
+                int want = reference_contains(text, n, query, m);
+                if (text_contains_nocase((const char*)text, (const char*)query) != want) {
+                    printf("FAIL %s kernel: text length %d, query length %d at %d, expected %s\n",
+                           kernels[k], n, m, at, want ? "a match" : "no match");
+                    bad = 1;
+                }
+            }
+        }
+        failures += bad;
+    }
+    use_text_match_kernel(NULL);
+    rng_state = saved_rng;
+    return failures;
+}
+
+static void usage(void) {
+    printf("usage:\n"
+           "  calendar_cli bench [N ...]          time generate/save/load/edit/export...\n"
+           "  calendar_cli check                  run the self-checks; exit status 1 on failure\n"
+           "  calendar_cli generate N [file]      write N synthetic events\n"
+           "  calendar_cli export out.csv [file]  export a data file to CSV\n"
+           "  calendar_cli import in.csv [file]   add the rows of a CSV export to a data file\n"
+           "  calendar_cli count [file]           print the number of events\n"
+           "  calendar_cli stats [file]           print the dashboard figures\n"
+           "  calendar_cli conflicts dd/mm/yyyy dd/mm/yyyy [file]\n"
+           "                                      list overlapping events in a date range\n"
+           "  calendar_cli slots dd/mm/yyyy DAYS MINUTES [HH:MM-HH:MM] [file]\n"
+           "                                      free weekday slots (default 09:00-18:00,\n"
+           "                                      reminders do not block)\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    if (strcmp(argv[1], "bench") == 0) {
+        int defaults[] = {1000, 100000, 1000000};
+        printf("   events  step          time\n");
+        if (argc > 2) {
+            for (int i = 2; i < argc; i++) run_bench(atoi(argv[i]));
+        } else {
+            for (int i = 0; i < 3; i++) run_bench(defaults[i]);
+        }
+        return bench_failures ? 1 : 0;
+    }
+
+    if (strcmp(argv[1], "check") == 0) {
+        int failures = check_legacy_quotes();
+        failures += check_short_rows();
+        failures += check_bad_record_date();
+        failures += check_series_overlaps();
+        failures += check_match_kernels();
+        printf("%s\n", failures ? "check failed" : "all checks passed");
+        return failures ? 1 : 0;
+    }
+
+    if (strcmp(argv[1], "generate") == 0 && argc >= 3) {
+        const char *file = argc > 3 ? argv[3] : DATA_FILE;
+        generate_events(atoi(argv[2]));
+        if (!save_events_to(file)) {
+            fprintf(stderr, "Cannot write %s\n", file);
+            return 1;
+        }
+        printf("Wrote %d events to %s\n", count_events(), file);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "export") == 0 && argc >= 3) {
+        const char *file = argc > 3 ? argv[3] : DATA_FILE;
+        if (!load_events_from(file)) {
+            fprintf(stderr, "Cannot read %s\n", file);
+            return 1;
+        }
+        replay_journal(file);
+        if (!export_to_csv(argv[2])) {
+            fprintf(stderr, "Cannot write %s\n", argv[2]);
+            return 1;
+        }
+        printf("Exported %d events to %s\n", count_events(), argv[2]);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "import") == 0 && argc >= 3) {
+        // A missing data file is created; the import is saved once at the end
+        const char *file = argc > 3 ? argv[3] : DATA_FILE;
+        ImportResult res;
+        load_events_from(file);
+        open_journal(file);
+        double t0 = now_ms();
+        int ok = import_from_csv(argv[2], &res, print_bad_line, argv[2]);
+        double t1 = now_ms();
+        if (!checkpoint_journal()) {
+            fprintf(stderr, "Cannot write %s\n", file);
+            return 1;
+        }
+        close_journal();
+        printf("Imported %d of %ld rows from %s in %.2f ms (%.0f rows/s, %d rejected)\n",
+               res.imported, res.lines, argv[2], t1 - t0,
+               t1 > t0 ? res.lines / ((t1 - t0) / 1000.0) : 0.0, res.rejected);
+        return ok ? 0 : 1;
+    }
+
+    if (strcmp(argv[1], "stats") == 0) {
+        const char *file = argc > 2 ? argv[2] : DATA_FILE;
+        if (!load_events_from(file)) {
+            fprintf(stderr, "Cannot read %s\n", file);
+            return 1;
+        }
+        replay_journal(file);
+        print_stats();
+        return 0;
+    }
+
+    if (strcmp(argv[1], "conflicts") == 0 && argc >= 4) {
+        const char *file = argc > 4 ? argv[4] : DATA_FILE;
+        Date from, to;
+        if (sscanf(argv[2], "%d/%d/%d", &from.day, &from.month, &from.year) != 3 ||
+            sscanf(argv[3], "%d/%d/%d", &to.day, &to.month, &to.year) != 3) {
+            usage();
+            return 1;
+        }
+        if (!load_events_from(file)) {
+            fprintf(stderr, "Cannot read %s\n", file);
+            return 1;
+        }
+        replay_journal(file);
+        print_conflicts(from, to);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "slots") == 0 && argc >= 5) {
+        SlotQuery q;
+        office_hours_query(&q, atoi(argv[4]));
+        int days = atoi(argv[3]), arg = 5;
+        if (sscanf(argv[2], "%d/%d/%d", &q.from.day, &q.from.month, &q.from.year) != 3 || days < 1) {
+            usage();
+            return 1;
+        }
+        if (argc > arg && sscanf(argv[arg], "%d:%d-%d:%d", &q.day_start.hour, &q.day_start.minute,
+                                 &q.day_end.hour, &q.day_end.minute) == 4) {
+            arg++;
+        }
+        const char *file = argc > arg ? argv[arg] : DATA_FILE;
+        q.to = days_to_date(date_to_days(q.from) + days - 1);
+        if (!load_events_from(file)) {
+            fprintf(stderr, "Cannot read %s\n", file);
+            return 1;
+        }
+        replay_journal(file);
+        print_free_slots(&q);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "count") == 0) {
+        const char *file = argc > 2 ? argv[2] : DATA_FILE;
+        if (!load_events_from(file)) {
+            fprintf(stderr, "Cannot read %s\n", file);
+            return 1;
+        }
+        replay_journal(file);
+        printf("%d\n", count_events());
+        return 0;
+    }
+
+    usage();
+    return 1;
+}
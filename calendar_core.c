@@ -0,0 +1,4085 @@
+// Portable event store: event table, persistence and CSV export.
+// gcc -c calendar_core.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <limits.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#include "calendar_core.h"
+#include "calendar_platform.h"
+
+// Event arena: fixed-size Event slots carved out of large chunks. Slots
+// never move, so Event pointers stay valid until the slot is recycled, and
+// teardown releases whole chunks instead of one allocation per event.
+#define ARENA_CHUNK_SHIFT 12
+#define ARENA_CHUNK_EVENTS (1 << ARENA_CHUNK_SHIFT)
+#define ARENA_CHUNK_MASK (ARENA_CHUNK_EVENTS - 1)
+
+typedef struct {
+    Event **chunks;
+    int chunk_count, chunk_capacity;
+    int used;
+} EventArena;
+
+// String pool: interned, NUL-terminated strings packed into large chunks.
+// Strings never move; edits intern a new string and leave the old one
+// behind, so the pool is rebuilt from live events once garbage dominates.
+#define POOL_CHUNK_SIZE (64 * 1024)
+#define POOL_MIN_REBUILD (1024 * 1024)
+
+typedef struct {
+    char **chunks;
+    int chunk_count, chunk_capacity;
+    size_t chunk_used;
+    const char **hash_slots;
+    size_t hash_capacity, hash_count;
+    size_t bytes;
+    size_t live_bytes;
+} StringPool;
+
+// Live slots ordered by one list column
+typedef struct {
+    int *slots;
+    int count, capacity;
+    int built;
+} SortIndex;
+
+// Slots whose text contains one trigram
+typedef struct {
+    int *slots;
+    int count, capacity;
+} Posting;
+
+// Trigram -> Posting hash table, see the Search index section
+typedef struct {
+    unsigned *keys;          // folded trigram, 0 marks an empty bucket
+    Posting *lists;
+    size_t capacity, used;
+    size_t entries;          // slots listed across all postings
+    size_t stale;            // entries left behind by edits and deletes
+    int *seen;               // per-slot query stamp
+    int seen_capacity, seen_initialised;
+    int stamp;
+    int *results;            // ids returned by the last search_events
+    int result_count, result_capacity;
+    int built;
+} SearchIndex;
+
+// Events per day and priority for one calendar month
+typedef struct {
+    int key;                 // year * 12 + month, 0 marks an empty bucket
+    unsigned busy;           // bit day - 1 set while that day has events
+    int total;
+    int counts[31][4];
+} MonthDays;
+
+typedef struct {
+    MonthDays *months;       // open-addressed by key
+    size_t capacity, used;
+    int built;
+} DayIndex;
+
+// Running totals over live events for the statistics dashboard
+typedef struct {
+    int total, all_day, with_reminder, repeating;
+    int priorities[4];
+    int categories[8];
+    long long category_minutes[8];
+    int built;
+    // Busiest days, ranked on first read after each change
+    DayCount busiest[STATS_BUSIEST_DAYS];
+    int busiest_count;
+    int busiest_ranked;
+    unsigned long busiest_version;
+} StatsIndex;
+
+// Hot filter fields mirrored per `order` position, one narrow column each,
+// so filters read a few bytes per event instead of whole Event slots
+typedef struct {
+    int *day;                // date key
+    unsigned char *priority;
+    unsigned char *category;
+    unsigned char *dead;     // 1 for a tombstone
+    int capacity;
+    int built;
+} FilterColumns;
+
+// Node of the interval tree, indexed by slot
+typedef struct {
+    long long start, end;    // minutes since 1970, end excluded
+    long long max_end;       // latest end in the subtree
+    int left, right;         // slots, -1 for none
+} IntervalNode;
+
+typedef struct {
+    IntervalNode *nodes;
+    int capacity;
+    int root;                // -1 when empty
+    int *hits;               // slots found by the last query
+    int hit_count, hit_capacity;
+    int built;
+} IntervalTree;
+
+// Queued reminder: minute it is due, the slot of its event and the date
+// key of the occurrence it is for
+typedef struct {
+    long long due;
+    int slot;
+    int key;
+} ReminderEntry;
+
+// Binary min-heap of reminders by due minute. `pos` maps a slot to its
+// heap position (-1 if not queued), so edits and deletes are O(log n).
+typedef struct {
+    ReminderEntry *items;
+    int count, capacity;
+    int *pos;
+    int pos_capacity;
+    int built;
+} ReminderHeap;
+
+// Event table: records live in arena slots, `order` keeps them sorted by
+// (date, start time, id) and `id_slot` maps an id straight to its slot.
+// Deleted events stay in `order` as tombstones until compaction moves
+// their slots onto `free_slots` for reuse.
+typedef struct {
+    EventArena arena;
+    StringPool strings;
+    int *order;
+    int order_count, order_capacity;
+    int *id_slot;
+    int id_capacity;
+    int *free_slots;
+    int free_count, free_capacity;
+    int live_count;
+    int dead_count;
+    int compactions;
+    SortIndex sorted[SORT_COLUMNS];
+    SearchIndex search;
+    DayIndex days;
+    ReminderHeap reminders;
+    StatsIndex stats;
+    FilterColumns columns;
+    IntervalTree intervals;
+    int *series;             // slots of live events with a recurrence rule
+    int series_count, series_capacity;
+} EventTable;
+
+// Compact once tombstones make up this share of `order` (and at least
+// COMPACT_MIN_DEAD of them), so each delete costs amortised O(1).
+#define COMPACT_MIN_DEAD 64
+#define COMPACT_DEAD_PERCENT 25
+
+// On-disk record of the 0xCAFEBABE format: the original linked-list node
+// minus its trailing next pointer, kept so old files load unchanged.
+#define LEGACY_DESC 200
+#define LEGACY_LOC 100
+
+typedef struct DiskEvent {
+    int id;
+    Date date;
+    Time start_time, end_time;
+    char description[LEGACY_DESC];
+    char location[LEGACY_LOC];
+    Priority priority;
+    Category category;
+    int is_all_day;
+    int reminder_minutes;
+    int deleted;
+    struct DiskEvent *next;
+} DiskEvent;
+
+#define DISK_EVENT_SIZE (sizeof(DiskEvent) - sizeof(struct DiskEvent*))
+
+// Open write-ahead journal; see the Journal section below
+typedef struct {
+    FILE *fp;
+    char base[1024];     // data file the journal belongs to
+    char path[1024];
+    size_t bytes;        // journal size once queued entries are written
+} Journal;
+
+// Queued write for the persistence worker; data is owned by the job
+typedef struct PersistJob {
+    int kind;                 // PERSIST_JOURNAL, PERSIST_CHECKPOINT or PERSIST_BACKUP
+    unsigned char *data;
+    size_t size;
+    char *path;               // destination of a backup
+    struct PersistJob *next;
+} PersistJob;
+
+typedef struct {
+    PlatformThread *thread;
+    PlatformMonitor *monitor;
+    PersistJob *head, *tail;
+    int busy;                 // worker is writing a batch
+    int stopping;
+    PersistCallback done;
+    void *user;
+} PersistWorker;
+
+// Runs chunk number `chunk` of a parallel scan: positions first .. end - 1
+typedef void (*ScanTask)(int chunk, int first, int end, void *arg);
+
+// Shared scan workers; see the Parallel scans section
+typedef struct {
+    PlatformMonitor *monitor;
+    PlatformThread *threads[SCAN_MAX_THREADS - 1];
+    int started;
+    int threads_wanted;       // set_scan_threads, 0 = one per processor
+    unsigned long job;        // bumped for every job handed out
+    ScanTask task;
+    void *arg;
+    int n, chunk_size, chunks;
+    int next, done;           // chunks claimed and chunks finished
+    int helpers, joined;      // workers allowed on and taking part in the job
+    int running;
+    int stopping;
+} ScanPool;
+
+// Ids index a direct-mapped array, so files claiming absurd ids are
+// treated as corrupt rather than allowed to size it
+#define MAX_EVENT_ID (1 << 25)
+
+// Global variables
+static EventTable table;
+static MappedFile mapped_file;   // file the table's text points into, if any
+static Journal journal;           // write-ahead log of the loaded file, if open
+static PersistWorker persist;     // background writer, if started
+static ScanPool scan;             // parallel scan workers, started on demand
+static int bulk_mode = 0;
+static int bulk_sorted = 1;
+static unsigned long store_changes = 0;   // see store_version
+static long long reminders_delivered = LLONG_MIN;   // see pop_due_reminders
+int next_id = 1;
+
+// Utility functions
+int is_leap_year(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
+}
+
+int days_in_month(int month, int year) {
+    int days[] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    if (month == 2 && is_leap_year(year)) return 29;
+    return days[month-1];
+}
+
+int compare_dates(Date d1, Date d2) {
+    if (d1.year != d2.year) return d1.year - d2.year;
+    if (d1.month != d2.month) return d1.month - d2.month;
+    return d1.day - d2.day;
+}
+
+// Civil-calendar day count (proleptic Gregorian)
+int date_to_days(Date d) {
+    int y = d.year - (d.month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * ((d.month + 9) % 12) + 2) / 5 + d.day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+Date days_to_date(int days) {
+    Date d;
+    int z = days + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    d.day = doy - (153 * mp + 2) / 5 + 1;
+    d.month = mp < 10 ? mp + 3 : mp - 9;
+    d.year = yoe + era * 400 + (d.month <= 2);
+    return d;
+}
+
+int day_of_week(Date d) {
+    // 1 January 1970 was a Thursday
+    int w = (date_to_days(d) + 3) % 7;
+    return w < 0 ? w + 7 : w;
+}
+
+void get_today(Date *d) {
+    time_t now = time(NULL);
+    struct tm *t = localtime(&now);
+    d->day = t->tm_mday;
+    d->month = t->tm_mon + 1;
+    d->year = t->tm_year + 1900;
+}
+
+long long local_minute_now(void) {
+    time_t now = time(NULL);
+    struct tm *t = localtime(&now);
+    Date d = { t->tm_mday, t->tm_mon + 1, t->tm_year + 1900 };
+    return (long long)date_to_days(d) * 1440 + t->tm_hour * 60 + t->tm_min;
+}
+
+// Start of the occurrence of e on day key
+static long long occurrence_start_minute(const Event *e, int key) {
+    long long day = (long long)key * 1440;
+    if (e->is_all_day) return day;
+    return day + e->start_time.hour * 60 + e->start_time.minute;
+}
+
+long long event_start_minute(const Event *e) {
+    return occurrence_start_minute(e, e->date_key);
+}
+
+const char* priority_to_string(Priority p) {
+    switch(p) {
+        case PRIORITY_LOW: return "Low";
+        case PRIORITY_MEDIUM: return "Medium";
+        case PRIORITY_HIGH: return "High";
+        case PRIORITY_CRITICAL: return "Critical";
+        default: return "Unknown";
+    }
+}
+
+const char* category_to_string(Category c) {
+    const char *cats[] = {"Work", "Personal", "Birthday", "Meeting",
+                          "Appointment", "Reminder", "Holiday", "Other"};
+    return cats[c];
+}
+
+// Portable stand-in for _strlwr
+char* str_to_lower(char *s) {
+    for (char *p = s; *p; p++) {
+        *p = (char)tolower((unsigned char)*p);
+    }
+    return s;
+}
+
+// Table helpers
+static int grow_array(void **arr, int *capacity, int needed, size_t elem_size) {
+    if (needed <= *capacity) return 1;
+    int cap = *capacity ? *capacity : 64;
+    while (cap < needed) cap *= 2;
+    void *p = realloc(*arr, (size_t)cap * elem_size);
+    if (!p) return 0;
+    *arr = p;
+    *capacity = cap;
+    return 1;
+}
+
+// Arena
+static inline Event* slot_event(int slot) {
+    return &table.arena.chunks[slot >> ARENA_CHUNK_SHIFT][slot & ARENA_CHUNK_MASK];
+}
+
+static int arena_alloc(EventArena *a) {
+    if ((a->used & ARENA_CHUNK_MASK) == 0 && (a->used >> ARENA_CHUNK_SHIFT) == a->chunk_count) {
+        if (!grow_array((void**)&a->chunks, &a->chunk_capacity,
+                        a->chunk_count + 1, sizeof(Event*))) return -1;
+        Event *chunk = (Event*)malloc(ARENA_CHUNK_EVENTS * sizeof(Event));
+        if (!chunk) return -1;
+        a->chunks[a->chunk_count++] = chunk;
+    }
+    return a->used++;
+}
+
+static void arena_free(EventArena *a) {
+    for (int i = 0; i < a->chunk_count; i++) free(a->chunks[i]);
+    free(a->chunks);
+    memset(a, 0, sizeof(*a));
+}
+
+// String pool
+static size_t hash_string(const char *str) {
+    size_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char*)str; *p; p++) {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h;
+}
+
+static char* pool_store(StringPool *sp, const char *str, size_t len) {
+    if (sp->chunk_count == 0 || sp->chunk_used + len + 1 > POOL_CHUNK_SIZE) {
+        size_t size = len + 1 > POOL_CHUNK_SIZE ? len + 1 : POOL_CHUNK_SIZE;
+        if (!grow_array((void**)&sp->chunks, &sp->chunk_capacity,
+                        sp->chunk_count + 1, sizeof(char*))) return NULL;
+        char *chunk = (char*)malloc(size);
+        if (!chunk) return NULL;
+        // Oversized strings get a private chunk; keep filling the previous one
+        if (size > POOL_CHUNK_SIZE && sp->chunk_count > 0) {
+            sp->chunks[sp->chunk_count] = sp->chunks[sp->chunk_count - 1];
+            sp->chunks[sp->chunk_count - 1] = chunk;
+            sp->chunk_count++;
+            memcpy(chunk, str, len + 1);
+            sp->bytes += len + 1;
+            return chunk;
+        }
+        sp->chunks[sp->chunk_count++] = chunk;
+        sp->chunk_used = 0;
+    }
+    char *dst = sp->chunks[sp->chunk_count - 1] + sp->chunk_used;
+    memcpy(dst, str, len + 1);
+    sp->chunk_used += len + 1;
+    sp->bytes += len + 1;
+    return dst;
+}
+
+static int pool_rehash(StringPool *sp, size_t capacity) {
+    const char **slots = (const char**)calloc(capacity, sizeof(const char*));
+    if (!slots) return 0;
+    for (size_t i = 0; i < sp->hash_capacity; i++) {
+        const char *str = sp->hash_slots[i];
+        if (!str) continue;
+        size_t h = hash_string(str) & (capacity - 1);
+        while (slots[h]) h = (h + 1) & (capacity - 1);
+        slots[h] = str;
+    }
+    free(sp->hash_slots);
+    sp->hash_slots = slots;
+    sp->hash_capacity = capacity;
+    return 1;
+}
+
+// Returns the pool's copy of str, adding it on first use
+static const char* pool_intern(StringPool *sp, const char *str) {
+    if (!str || !*str) return "";
+    if ((sp->hash_count + 1) * 2 > sp->hash_capacity &&
+        !pool_rehash(sp, sp->hash_capacity ? sp->hash_capacity * 2 : 1024)) return NULL;
+
+    size_t h = hash_string(str) & (sp->hash_capacity - 1);
+    while (sp->hash_slots[h]) {
+        if (strcmp(sp->hash_slots[h], str) == 0) return sp->hash_slots[h];
+        h = (h + 1) & (sp->hash_capacity - 1);
+    }
+    const char *copy = pool_store(sp, str, strlen(str));
+    if (!copy) return NULL;
+    sp->hash_slots[h] = copy;
+    sp->hash_count++;
+    return copy;
+}
+
+static void pool_free(StringPool *sp) {
+    for (int i = 0; i < sp->chunk_count; i++) free(sp->chunks[i]);
+    free(sp->chunks);
+    free(sp->hash_slots);
+    memset(sp, 0, sizeof(*sp));
+}
+
+static int ensure_id_capacity(int id) {
+    if (id <= 0 || id > MAX_EVENT_ID) return 0;
+    int old = table.id_capacity;
+    if (!grow_array((void**)&table.id_slot, &table.id_capacity, id + 1, sizeof(int))) return 0;
+    for (int i = old; i < table.id_capacity; i++) table.id_slot[i] = -1;
+    return 1;
+}
+
+static int event_cmp(const Event *a, const Event *b) {
+    if (a->date_key != b->date_key) return a->date_key < b->date_key ? -1 : 1;
+    int sa = a->is_all_day ? -1 : a->start_time.hour * 60 + a->start_time.minute;
+    int sb = b->is_all_day ? -1 : b->start_time.hour * 60 + b->start_time.minute;
+    if (sa != sb) return sa - sb;
+    return a->id - b->id;
+}
+
+static int order_slot_cmp(const void *a, const void *b) {
+    return event_cmp(slot_event(*(const int*)a), slot_event(*(const int*)b));
+}
+
+// First order position whose event sorts at or after e
+static int order_lower_bound(const Event *e) {
+    int lo = 0, hi = table.order_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (event_cmp(slot_event(table.order[mid]), e) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Filter columns
+// Position-aligned with `order`: every shift of `order` is mirrored here
+// while the columns are built. Built on first use; bulk inserts drop them.
+static void drop_columns(void) {
+    FilterColumns *c = &table.columns;
+    free(c->day);
+    free(c->priority);
+    free(c->category);
+    free(c->dead);
+    memset(c, 0, sizeof(*c));
+}
+
+static int reserve_columns(int needed) {
+    FilterColumns *c = &table.columns;
+    if (needed <= c->capacity) return 1;
+    int cap = c->capacity ? c->capacity : 64;
+    while (cap < needed) cap *= 2;
+    size_t n = (size_t)cap;
+    int *day = (int*)realloc(c->day, n * sizeof(int));
+    if (day) c->day = day;
+    unsigned char *pri = (unsigned char*)realloc(c->priority, n);
+    if (pri) c->priority = pri;
+    unsigned char *cat = (unsigned char*)realloc(c->category, n);
+    if (cat) c->category = cat;
+    unsigned char *dead = (unsigned char*)realloc(c->dead, n);
+    if (dead) c->dead = dead;
+    if (!day || !pri || !cat || !dead) {
+        drop_columns();
+        return 0;
+    }
+    c->capacity = cap;
+    return 1;
+}
+
+static void set_columns(int pos, const Event *e) {
+    table.columns.day[pos] = e->date_key;
+    table.columns.priority[pos] = (unsigned char)e->priority;
+    table.columns.category[pos] = (unsigned char)e->category;
+    table.columns.dead[pos] = (unsigned char)(e->deleted != 0);
+}
+
+static void build_columns(void) {
+    if (table.columns.built || !reserve_columns(table.order_count)) return;
+    for (int i = 0; i < table.order_count; i++) set_columns(i, slot_event(table.order[i]));
+    table.columns.built = 1;
+}
+
+// Called before `order` opens position pos for slot
+static void columns_insert(int pos, int slot) {
+    FilterColumns *c = &table.columns;
+    if (!c->built) return;
+    if (!reserve_columns(table.order_count + 1)) return;
+    size_t n = (size_t)(table.order_count - pos);
+    memmove(&c->day[pos + 1], &c->day[pos], n * sizeof(int));
+    memmove(&c->priority[pos + 1], &c->priority[pos], n);
+    memmove(&c->category[pos + 1], &c->category[pos], n);
+    memmove(&c->dead[pos + 1], &c->dead[pos], n);
+    set_columns(pos, slot_event(slot));
+}
+
+// Called before `order` closes position pos
+static void columns_remove(int pos) {
+    FilterColumns *c = &table.columns;
+    if (!c->built) return;
+    size_t n = (size_t)(table.order_count - pos - 1);
+    memmove(&c->day[pos], &c->day[pos + 1], n * sizeof(int));
+    memmove(&c->priority[pos], &c->priority[pos + 1], n);
+    memmove(&c->category[pos], &c->category[pos + 1], n);
+    memmove(&c->dead[pos], &c->dead[pos + 1], n);
+}
+
+static int order_insert(int slot) {
+    if (!grow_array((void**)&table.order, &table.order_capacity,
+                    table.order_count + 1, sizeof(int))) return 0;
+    if (bulk_mode) {
+        // Append now, sort once in end_bulk_insert
+        if (table.order_count > 0 &&
+            event_cmp(slot_event(table.order[table.order_count - 1]), slot_event(slot)) > 0) {
+            bulk_sorted = 0;
+        }
+        table.order[table.order_count++] = slot;
+        return 1;
+    }
+    int pos = order_lower_bound(slot_event(slot));
+    columns_insert(pos, slot);
+    memmove(&table.order[pos + 1], &table.order[pos],
+            (size_t)(table.order_count - pos) * sizeof(int));
+    table.order[pos] = slot;
+    table.order_count++;
+    return 1;
+}
+
+// Position of slot in `order`, or -1
+static int order_position(int slot) {
+    int pos = order_lower_bound(slot_event(slot));
+    while (pos < table.order_count && table.order[pos] != slot) pos++;
+    return pos < table.order_count ? pos : -1;
+}
+
+static void order_remove(int slot) {
+    int pos = order_position(slot);
+    if (pos < 0) return;
+    columns_remove(pos);
+    memmove(&table.order[pos], &table.order[pos + 1],
+            (size_t)(table.order_count - pos - 1) * sizeof(int));
+    table.order_count--;
+}
+
+// Sort indexes
+static int compare_nocase(const char *a, const char *b) {
+    for (;; a++, b++) {
+        int ca = tolower((unsigned char)*a), cb = tolower((unsigned char)*b);
+        if (ca != cb || !ca) return ca - cb;
+    }
+}
+
+int compare_events_by(SortColumn col, const Event *a, const Event *b) {
+    int c = 0;
+    switch (col) {
+        case SORT_ID: return a->id - b->id;
+        case SORT_TIME: {
+            int sa = a->is_all_day ? -1 : a->start_time.hour * 60 + a->start_time.minute;
+            int sb = b->is_all_day ? -1 : b->start_time.hour * 60 + b->start_time.minute;
+            c = sa - sb;
+            break;
+        }
+        case SORT_DESCRIPTION: c = compare_nocase(a->description, b->description); break;
+        case SORT_LOCATION: c = compare_nocase(a->location, b->location); break;
+        case SORT_PRIORITY: c = (int)a->priority - (int)b->priority; break;
+        case SORT_CATEGORY:
+            c = strcmp(category_to_string(a->category), category_to_string(b->category));
+            break;
+        default: break;
+    }
+    return c != 0 ? c : event_cmp(a, b);
+}
+
+static SortColumn qsort_column;
+
+static int sort_slot_cmp(const void *a, const void *b) {
+    return compare_events_by(qsort_column, slot_event(*(const int*)a), slot_event(*(const int*)b));
+}
+
+static int sort_lower_bound(SortColumn col, const Event *e) {
+    SortIndex *si = &table.sorted[col];
+    int lo = 0, hi = si->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (compare_events_by(col, slot_event(si->slots[mid]), e) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void drop_sort_index(SortIndex *si) {
+    free(si->slots);
+    memset(si, 0, sizeof(*si));
+}
+
+static void drop_sort_indexes(void) {
+    for (int c = 0; c < SORT_COLUMNS; c++) drop_sort_index(&table.sorted[c]);
+}
+
+static int build_sort_index(SortColumn col) {
+    SortIndex *si = &table.sorted[col];
+    if (si->built) return 1;
+    if (!grow_array((void**)&si->slots, &si->capacity, table.live_count, sizeof(int))) return 0;
+    si->count = 0;
+    for (int i = 0; i < table.order_count; i++) {
+        if (!slot_event(table.order[i])->deleted) si->slots[si->count++] = table.order[i];
+    }
+    // `order` is already date-sorted, which is exactly what SORT_DATE wants
+    if (col != SORT_DATE) {
+        qsort_column = col;
+        qsort(si->slots, si->count, sizeof(int), sort_slot_cmp);
+    }
+    si->built = 1;
+    return 1;
+}
+
+// Called after a slot's event gained its current field values
+static void sort_indexes_insert(int slot) {
+    for (int c = 0; c < SORT_COLUMNS; c++) {
+        SortIndex *si = &table.sorted[c];
+        if (!si->built) continue;
+        if (!grow_array((void**)&si->slots, &si->capacity, si->count + 1, sizeof(int))) {
+            drop_sort_index(si);
+            continue;
+        }
+        int pos = sort_lower_bound((SortColumn)c, slot_event(slot));
+        memmove(&si->slots[pos + 1], &si->slots[pos], (size_t)(si->count - pos) * sizeof(int));
+        si->slots[pos] = slot;
+        si->count++;
+    }
+}
+
+// Called before a slot's event changes fields or is deleted
+static void sort_indexes_remove(int slot) {
+    for (int c = 0; c < SORT_COLUMNS; c++) {
+        SortIndex *si = &table.sorted[c];
+        if (!si->built) continue;
+        int pos = sort_lower_bound((SortColumn)c, slot_event(slot));
+        if (pos < si->count && si->slots[pos] == slot) {
+            memmove(&si->slots[pos], &si->slots[pos + 1], (size_t)(si->count - pos - 1) * sizeof(int));
+            si->count--;
+        }
+    }
+}
+
+int sorted_event_count(SortColumn col) {
+    if (col < 0 || col >= SORT_COLUMNS || !build_sort_index(col)) return 0;
+    return table.sorted[col].count;
+}
+
+Event* sorted_event_at(SortColumn col, int pos) {
+    return slot_event(table.sorted[col].slots[pos]);
+}
+
+// Search index
+// Trigram postings over the case-folded description and location. Each
+// posting lists the slots whose text contains that trigram. Edits and
+// deletes do not remove old entries; queries re-check every candidate
+// against the real text, and the index is rebuilt once stale entries
+// outnumber live ones.
+#define SEARCH_MIN_QUERY 3
+#define SEARCH_LOCAL_TRIGRAMS 256
+
+static unsigned char fold_table[256];
+
+static void init_fold_table(void) {
+    if (fold_table['A']) return;
+    for (int c = 0; c < 256; c++) fold_table[c] = (unsigned char)tolower(c);
+}
+
+// Case-insensitive substring test without copying either string.
+// The vector kernels look for the query's first and last bytes 16 or 32
+// positions at a time, with bit 0x20 forced on so both cases of a letter
+// compare equal, and confirm each candidate with the fold table. The
+// widest kernel the CPU supports is picked on first use.
+typedef int (*TextMatchKernel)(const unsigned char *t, size_t n, const unsigned char *q, size_t m);
+
+static TextMatchKernel text_match;
+static const char *text_match_name = "scalar";
+
+static int match_at(const unsigned char *t, const unsigned char *q, size_t m) {
+    for (size_t k = 0; k < m; k++) {
+        if (fold_table[t[k]] != fold_table[q[k]]) return 0;
+    }
+    return 1;
+}
+
+static int match_scalar(const unsigned char *t, size_t n, const unsigned char *q, size_t m) {
+    unsigned char first = fold_table[q[0]];
+    for (size_t i = 0; i + m <= n; i++) {
+        if (fold_table[t[i]] == first && match_at(t + i, q, m)) return 1;
+    }
+    return 0;
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("sse2")))
+static int match_sse2(const unsigned char *t, size_t n, const unsigned char *q, size_t m) {
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i first = _mm_set1_epi8((char)(fold_table[q[0]] | 0x20));
+    const __m128i last = _mm_set1_epi8((char)(fold_table[q[m - 1]] | 0x20));
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i*)(t + i)), lower);
+        __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i*)(t + i + m - 1)), lower);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first),
+                                                                  _mm_cmpeq_epi8(b, last)));
+        for (; mask; mask &= mask - 1) {
+            if (match_at(t + i + __builtin_ctz(mask), q, m)) return 1;
+        }
+    }
+    return match_scalar(t + i, n - i, q, m);
+}
+
+__attribute__((target("avx2")))
+static int match_avx2(const unsigned char *t, size_t n, const unsigned char *q, size_t m) {
+    const __m256i lower = _mm256_set1_epi8(0x20);
+    const __m256i first = _mm256_set1_epi8((char)(fold_table[q[0]] | 0x20));
+    const __m256i last = _mm256_set1_epi8((char)(fold_table[q[m - 1]] | 0x20));
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(t + i)), lower);
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(t + i + m - 1)), lower);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                                        _mm256_cmpeq_epi8(b, last)));
+        for (; mask; mask &= mask - 1) {
+            if (match_at(t + i + __builtin_ctz(mask), q, m)) return 1;
+        }
+    }
+    // One 16-byte step for shorter text. Calling match_sse2 instead would
+    // mix in legacy SSE code, whose state transitions cost more than the
+    // whole search.
+    if (i + m - 1 + 16 <= n) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i*)(t + i)), _mm256_castsi256_si128(lower));
+        __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i*)(t + i + m - 1)), _mm256_castsi256_si128(lower));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, _mm256_castsi256_si128(first)),
+                                                                  _mm_cmpeq_epi8(b, _mm256_castsi256_si128(last))));
+        for (; mask; mask &= mask - 1) {
+            if (match_at(t + i + __builtin_ctz(mask), q, m)) return 1;
+        }
+        i += 16;
+    }
+    return match_scalar(t + i, n - i, q, m);
+}
+#endif
+
+static void init_text_match(void) {
+    if (text_match) return;
+    init_fold_table();
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        text_match_name = "avx2";
+        text_match = match_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        text_match_name = "sse2";
+        text_match = match_sse2;
+        return;
+    }
+#endif
+    text_match = match_scalar;
+}
+
+static int contains_nocase(const char *text, const char *query) {
+    init_text_match();
+    size_t m = strlen(query), n = strlen(text);
+    if (m == 0) return 1;
+    if (m > n) return 0;
+    return text_match((const unsigned char*)text, n, (const unsigned char*)query, m);
+}
+
+int text_contains_nocase(const char *text, const char *query) {
+    return contains_nocase(text, query);
+}
+
+const char* text_match_kernel(void) {
+    init_text_match();
+    return text_match_name;
+}
+
+int use_text_match_kernel(const char *name) {
+    text_match = NULL;
+    text_match_name = "scalar";
+    init_text_match();
+    if (!name || strcmp(name, text_match_name) == 0) return 1;
+    if (strcmp(name, "scalar") == 0) {
+        text_match = match_scalar;
+        text_match_name = "scalar";
+        return 1;
+    }
+#ifdef HAVE_X86_KERNELS
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        text_match = match_sse2;
+        text_match_name = "sse2";
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+static int text_matches(const Event *e, const char *query) {
+    return contains_nocase(e->description, query) || contains_nocase(e->location, query);
+}
+
+static int unsigned_cmp(const void *a, const void *b) {
+    unsigned x = *(const unsigned*)a, y = *(const unsigned*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Appends the folded trigrams of str to buf
+static int add_trigrams(const char *str, unsigned **buf, int *count, int *capacity, unsigned *local) {
+    const unsigned char *s = (const unsigned char*)str;
+    size_t len = strlen(str);
+    if (len < 3) return 1;
+    if (*count + (int)(len - 2) > *capacity) {
+        int needed = *count + (int)(len - 2);
+        unsigned *bigger = malloc((size_t)needed * sizeof(unsigned));
+        if (!bigger) return 0;
+        memcpy(bigger, *buf, (size_t)*count * sizeof(unsigned));
+        if (*buf != local) free(*buf);
+        *buf = bigger;
+        *capacity = needed;
+    }
+    for (size_t i = 0; i + 2 < len; i++) {
+        (*buf)[(*count)++] = (unsigned)fold_table[s[i]] << 16 |
+                             (unsigned)fold_table[s[i + 1]] << 8 | fold_table[s[i + 2]];
+    }
+    return 1;
+}
+
+// Distinct trigrams of an event's text, sorted. Returns the count or -1;
+// *out is local unless the text needed more room (caller frees then).
+static int event_trigrams(const Event *e, unsigned *local, unsigned **out) {
+    int count = 0, capacity = SEARCH_LOCAL_TRIGRAMS;
+    *out = local;
+    init_fold_table();
+    if (!add_trigrams(e->description, out, &count, &capacity, local) ||
+        !add_trigrams(e->location, out, &count, &capacity, local)) return -1;
+    // Typical text yields a few dozen trigrams, where insertion sort wins
+    unsigned *t = *out;
+    if (count > 64) {
+        qsort(t, count, sizeof(unsigned), unsigned_cmp);
+    } else {
+        for (int i = 1; i < count; i++) {
+            unsigned v = t[i];
+            int j = i;
+            while (j > 0 && t[j - 1] > v) {
+                t[j] = t[j - 1];
+                j--;
+            }
+            t[j] = v;
+        }
+    }
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || (*out)[unique - 1] != (*out)[i]) (*out)[unique++] = (*out)[i];
+    }
+    return unique;
+}
+
+static size_t trigram_hash(unsigned tri, size_t capacity) {
+    return ((size_t)tri * 2654435761u) & (capacity - 1);
+}
+
+// Posting for a trigram, or NULL if no text contains it
+static Posting* find_posting(unsigned tri) {
+    SearchIndex *si = &table.search;
+    if (!si->capacity) return NULL;
+    for (size_t i = trigram_hash(tri, si->capacity); si->keys[i]; i = (i + 1) & (si->capacity - 1)) {
+        if (si->keys[i] == tri) return &si->lists[i];
+    }
+    return NULL;
+}
+
+static int search_rehash(size_t capacity) {
+    SearchIndex *si = &table.search;
+    unsigned *keys = calloc(capacity, sizeof(unsigned));
+    Posting *lists = calloc(capacity, sizeof(Posting));
+    if (!keys || !lists) {
+        free(keys);
+        free(lists);
+        return 0;
+    }
+    for (size_t i = 0; i < si->capacity; i++) {
+        if (!si->keys[i]) continue;
+        size_t j = trigram_hash(si->keys[i], capacity);
+        while (keys[j]) j = (j + 1) & (capacity - 1);
+        keys[j] = si->keys[i];
+        lists[j] = si->lists[i];
+    }
+    free(si->keys);
+    free(si->lists);
+    si->keys = keys;
+    si->lists = lists;
+    si->capacity = capacity;
+    return 1;
+}
+
+static Posting* get_posting(unsigned tri) {
+    SearchIndex *si = &table.search;
+    if ((si->used + 1) * 2 > si->capacity && !search_rehash(si->capacity ? si->capacity * 2 : 4096)) {
+        return NULL;
+    }
+    size_t i = trigram_hash(tri, si->capacity);
+    while (si->keys[i] && si->keys[i] != tri) i = (i + 1) & (si->capacity - 1);
+    if (!si->keys[i]) {
+        si->keys[i] = tri;
+        si->used++;
+    }
+    return &si->lists[i];
+}
+
+static void drop_search_index(void) {
+    SearchIndex *si = &table.search;
+    for (size_t i = 0; i < si->capacity; i++) free(si->lists[i].slots);
+    free(si->keys);
+    free(si->lists);
+    free(si->seen);
+    free(si->results);
+    memset(si, 0, sizeof(*si));
+}
+
+// Adds a slot under every trigram of its text; drops the index on failure
+static void search_index_insert(int slot) {
+    SearchIndex *si = &table.search;
+    if (!si->built) return;
+    unsigned local[SEARCH_LOCAL_TRIGRAMS], *tris;
+    int n = event_trigrams(slot_event(slot), local, &tris);
+    for (int i = 0; i < n; i++) {
+        Posting *p = get_posting(tris[i]);
+        if (!p || !grow_array((void**)&p->slots, &p->capacity, p->count + 1, sizeof(int))) {
+            n = -1;
+            break;
+        }
+        p->slots[p->count++] = slot;
+        si->entries++;
+    }
+    if (tris != local) free(tris);
+    if (n < 0) drop_search_index();
+}
+
+// Marks the entries of a slot's current text as stale
+static void search_index_remove(int slot) {
+    SearchIndex *si = &table.search;
+    if (!si->built) return;
+    unsigned local[SEARCH_LOCAL_TRIGRAMS], *tris;
+    int n = event_trigrams(slot_event(slot), local, &tris);
+    if (tris != local) free(tris);
+    si->stale += n > 0 ? (size_t)n : 0;
+    if (si->stale > si->entries / 2) drop_search_index();
+}
+
+static int build_search_index(void) {
+    SearchIndex *si = &table.search;
+    if (si->built) return 1;
+    drop_search_index();
+    si->built = 1;
+    for (int i = 0; i < table.order_count && si->built; i++) {
+        if (!slot_event(table.order[i])->deleted) search_index_insert(table.order[i]);
+    }
+    return si->built;
+}
+
+static int search_result_cmp(const void *a, const void *b) {
+    return event_cmp(find_event_by_id(*(const int*)a), find_event_by_id(*(const int*)b));
+}
+
+int search_events(const char *query, const int **ids) {
+    SearchIndex *si = &table.search;
+    size_t len = strlen(query);
+    *ids = NULL;
+    if (len < SEARCH_MIN_QUERY || !build_search_index()) return -1;
+
+    // The rarest trigram of the query gives the fewest candidates
+    Posting *best = NULL;
+    const unsigned char *q = (const unsigned char*)query;
+    for (size_t i = 0; i + 2 < len; i++) {
+        unsigned tri = (unsigned)fold_table[q[i]] << 16 | (unsigned)fold_table[q[i + 1]] << 8 |
+                       fold_table[q[i + 2]];
+        Posting *p = find_posting(tri);
+        if (!p || p->count == 0) return 0;
+        if (!best || p->count < best->count) best = p;
+    }
+
+    // A slot can sit in a posting more than once after edits; stamps
+    // make sure each is checked once
+    if (!grow_array((void**)&si->seen, &si->seen_capacity, table.arena.used, sizeof(int))) return -1;
+    if (++si->stamp == 0 || si->seen_capacity > si->seen_initialised) {
+        memset(si->seen, 0, (size_t)si->seen_capacity * sizeof(int));
+        si->seen_initialised = si->seen_capacity;
+        si->stamp = 1;
+    }
+    si->result_count = 0;
+    for (int i = 0; i < best->count; i++) {
+        int slot = best->slots[i];
+        if (si->seen[slot] == si->stamp) continue;
+        si->seen[slot] = si->stamp;
+        Event *e = slot_event(slot);
+        if (e->deleted || !text_matches(e, query)) continue;
+        if (!grow_array((void**)&si->results, &si->result_capacity, si->result_count + 1, sizeof(int))) {
+            return -1;
+        }
+        si->results[si->result_count++] = e->id;
+    }
+    // Large result sets are put in date order by one pass over `order`
+    if (si->result_count > table.order_count / 16) {
+        for (int i = 0; i < si->result_count; i++) si->seen[table.id_slot[si->results[i]]] = -si->stamp;
+        si->result_count = 0;
+        for (int i = 0; i < table.order_count; i++) {
+            int slot = table.order[i];
+            if (si->seen[slot] == -si->stamp) si->results[si->result_count++] = slot_event(slot)->id;
+        }
+    } else {
+        qsort(si->results, si->result_count, sizeof(int), search_result_cmp);
+    }
+    *ids = si->results;
+    return si->result_count;
+}
+
+// Recurrence
+// A series is one event plus a rule. Its occurrences are computed from the
+// rule for whatever range is asked about and never stored, so a daily
+// series over ten years costs one event.
+#define NO_OCCURRENCE INT_MAX
+#define SKIPPED_PERIOD INT_MIN
+// Periods in a row that may lack the start day before a series is taken
+// to have ended (29 February every 100 years needs four)
+#define REPEAT_MAX_SKIPS 400
+#define REPEAT_MAX_INTERVAL 1000
+
+static int int_cmp(const void *a, const void *b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+static long long floor_div(long long a, long long b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int rule_valid(const Recurrence *r) {
+    if (r->frequency < REPEAT_DAILY || r->frequency > REPEAT_YEARLY) return 0;
+    if (r->interval < 1 || r->interval > REPEAT_MAX_INTERVAL) return 0;
+    if (r->count < 0 || r->count > MAX_REPEAT_COUNT) return 0;
+    if (r->exception_count < 0 || r->exception_count > MAX_REPEAT_EXCEPTIONS) return 0;
+    if (r->exception_count && !r->exceptions) return 0;
+    if (r->until.year && (r->until.year < 1 || r->until.year > 0xFFFF || r->until.month < 1 ||
+                          r->until.month > 12 || r->until.day < 1 ||
+                          r->until.day > days_in_month(r->until.month, r->until.year))) return 0;
+    return 1;
+}
+
+// Months between consecutive periods of a monthly or yearly rule
+static long long rule_months(const Recurrence *r) {
+    return (long long)(r->frequency == REPEAT_YEARLY ? 12 : 1) * r->interval;
+}
+
+// Day key of period n, SKIPPED_PERIOD if that month lacks the start day,
+// or NO_OCCURRENCE past the last representable year
+static int period_key(const Event *e, long long n) {
+    const Recurrence *r = e->repeat;
+    if (r->frequency == REPEAT_DAILY || r->frequency == REPEAT_WEEKLY) {
+        long long key = e->date_key + n * r->interval * (r->frequency == REPEAT_WEEKLY ? 7 : 1);
+        return key > INT_MAX / 2 ? NO_OCCURRENCE : (int)key;
+    }
+    long long m = (long long)e->date.year * 12 + (e->date.month - 1) + n * rule_months(r);
+    if (m / 12 > 0xFFFF) return NO_OCCURRENCE;
+    Date d = { e->date.day, (int)(m % 12) + 1, (int)(m / 12) };
+    if (d.day > days_in_month(d.month, d.year)) return SKIPPED_PERIOD;
+    return date_to_days(d);
+}
+
+// First period that can hold an occurrence on or after key
+static long long first_period(const Event *e, int key) {
+    const Recurrence *r = e->repeat;
+    if (key <= e->date_key) return 0;
+    if (r->frequency == REPEAT_DAILY || r->frequency == REPEAT_WEEKLY) {
+        long long step = (long long)r->interval * (r->frequency == REPEAT_WEEKLY ? 7 : 1);
+        return ((long long)key - e->date_key + step - 1) / step;
+    }
+    Date d = days_to_date(key);
+    long long months = ((long long)d.year * 12 + d.month - 1) - ((long long)e->date.year * 12 + e->date.month - 1);
+    return (months + rule_months(r) - 1) / rule_months(r);
+}
+
+static int is_exception(const Recurrence *r, int key) {
+    return r->exception_count &&
+           bsearch(&key, r->exceptions, r->exception_count, sizeof(int), int_cmp) != NULL;
+}
+
+// Day key of the first occurrence on or after key, or NO_OCCURRENCE.
+// A one-off event has a single occurrence on its date.
+static int occurrence_on_or_after(const Event *e, int key) {
+    const Recurrence *r = e->repeat;
+    if (!r) return key <= e->date_key ? e->date_key : NO_OCCURRENCE;
+    if (key > r->last_key) return NO_OCCURRENCE;
+    long long n = first_period(e, key);
+    for (int tries = 0; tries <= REPEAT_MAX_SKIPS + r->exception_count; tries++, n++) {
+        int k = period_key(e, n);
+        if (k == NO_OCCURRENCE || k > r->last_key) return NO_OCCURRENCE;
+        if (k != SKIPPED_PERIOD && k >= key && !is_exception(r, k)) return k;
+    }
+    return NO_OCCURRENCE;
+}
+
+// Day key of the last occurrence allowed by count and until. Exceptions
+// still use up the count, as in iCalendar.
+static int series_last_key(const Event *e) {
+    const Recurrence *r = e->repeat;
+    int last = r->until.year ? date_to_days(r->until) : NO_OCCURRENCE;
+    int found = 0, skipped = 0;
+    for (long long n = 0; r->count > 0 && found < r->count && skipped <= REPEAT_MAX_SKIPS; n++) {
+        int k = period_key(e, n);
+        if (k == NO_OCCURRENCE || k > last) break;
+        if (k == SKIPPED_PERIOD) {
+            skipped++;
+            continue;
+        }
+        skipped = 0;
+        if (++found == r->count) last = k;
+    }
+    return last;
+}
+
+static void series_track(int slot) {
+    if (grow_array((void**)&table.series, &table.series_capacity,
+                   table.series_count + 1, sizeof(int))) {
+        table.series[table.series_count++] = slot;
+    }
+}
+
+static void series_untrack(int slot) {
+    for (int i = 0; i < table.series_count; i++) {
+        if (table.series[i] == slot) {
+            table.series[i] = table.series[--table.series_count];
+            return;
+        }
+    }
+}
+
+// Store-owned copy of a rule with its exceptions sorted and deduplicated
+static Recurrence* copy_rule(const Recurrence *rule) {
+    Recurrence *copy = malloc(sizeof(Recurrence) + (size_t)rule->exception_count * sizeof(int));
+    if (!copy) return NULL;
+    *copy = *rule;
+    int *keys = (int*)(copy + 1);
+    if (rule->exception_count) {
+        memcpy(keys, rule->exceptions, (size_t)rule->exception_count * sizeof(int));
+        qsort(keys, rule->exception_count, sizeof(int), int_cmp);
+    }
+    int unique = 0;
+    for (int i = 0; i < rule->exception_count; i++) {
+        if (unique == 0 || keys[i] != keys[unique - 1]) keys[unique++] = keys[i];
+    }
+    copy->exceptions = keys;
+    copy->exception_count = unique;
+    return copy;
+}
+
+static void release_rule(Event *e) {
+    free((void*)e->repeat);
+    e->repeat = NULL;
+}
+
+static void indexes_insert(int slot);
+static void indexes_remove(int slot);
+
+int set_event_repeat(int id, const Recurrence *rule) {
+    Event *e = find_event_by_id(id);
+    if (!e) return 0;
+    Recurrence *copy = NULL;
+    if (rule && rule->frequency != REPEAT_NONE) {
+        if (!rule_valid(rule) || !(copy = copy_rule(rule))) return 0;
+    }
+    if (!copy && !e->repeat) return 1;
+
+    int slot = table.id_slot[id];
+    store_changes++;
+    indexes_remove(slot);
+    if (e->repeat) {
+        release_rule(e);
+        series_untrack(slot);
+    }
+    if (copy) {
+        e->repeat = copy;
+        copy->last_key = series_last_key(e);
+        series_track(slot);
+    }
+    indexes_insert(slot);
+    return 1;
+}
+
+int skip_occurrence(int id, Date d) {
+    Event *e = find_event_by_id(id);
+    int key = date_to_days(d);
+    if (!e || !e->repeat || occurrence_on_or_after(e, key) != key) return 0;
+    Recurrence rule = *e->repeat;
+    int *keys = malloc(((size_t)rule.exception_count + 1) * sizeof(int));
+    if (!keys) return 0;
+    memcpy(keys, rule.exceptions, (size_t)rule.exception_count * sizeof(int));
+    keys[rule.exception_count++] = key;
+    rule.exceptions = keys;
+    int ok = set_event_repeat(id, &rule);
+    free(keys);
+    return ok;
+}
+
+int next_occurrence(const Event *e, Date on_or_after, Date *occurrence) {
+    int key = occurrence_on_or_after(e, date_to_days(on_or_after));
+    if (key == NO_OCCURRENCE) return 0;
+    *occurrence = days_to_date(key);
+    return 1;
+}
+
+int series_count(void) {
+    return table.series_count;
+}
+
+Event* series_at(int i) {
+    if (i < 0 || i >= table.series_count) return NULL;
+    return slot_event(table.series[i]);
+}
+
+void describe_repeat(const Recurrence *r, char *buf, size_t size) {
+    static const char *units[] = { "", "day", "week", "month", "year" };
+    static const char *every[] = { "Does not repeat", "Daily", "Weekly", "Monthly", "Yearly" };
+    if (!r || r->frequency < REPEAT_DAILY || r->frequency > REPEAT_YEARLY) {
+        snprintf(buf, size, "%s", every[0]);
+        return;
+    }
+    int len;
+    if (r->interval == 1) len = snprintf(buf, size, "%s", every[r->frequency]);
+    else len = snprintf(buf, size, "Every %d %ss", r->interval, units[r->frequency]);
+    if (len > 0 && (size_t)len < size && r->count > 0) {
+        len += snprintf(buf + len, size - len, ", %d times", r->count);
+    }
+    if (len > 0 && (size_t)len < size && r->until.year) {
+        len += snprintf(buf + len, size - len, ", until %02d/%02d/%d",
+                        r->until.day, r->until.month, r->until.year);
+    }
+    if (len > 0 && (size_t)len < size && r->exception_count > 0) {
+        snprintf(buf + len, size - len, ", %d skipped", r->exception_count);
+    }
+}
+
+// Day index
+// Occupancy per calendar month: events per day and priority, plus a mask
+// of busy days, so the month calendar is answered without touching events.
+static int month_key(int year, int month) {
+    if (year < 0 || year > 0xFFFF || month < 1 || month > 12) return 0;
+    return year * 12 + month;
+}
+
+static size_t month_hash(int key, size_t capacity) {
+    return ((size_t)key * 2654435761u) & (capacity - 1);
+}
+
+static MonthDays* find_month(int key) {
+    DayIndex *di = &table.days;
+    if (!key || !di->capacity) return NULL;
+    for (size_t i = month_hash(key, di->capacity); di->months[i].key; i = (i + 1) & (di->capacity - 1)) {
+        if (di->months[i].key == key) return &di->months[i];
+    }
+    return NULL;
+}
+
+static MonthDays* get_month(int key) {
+    DayIndex *di = &table.days;
+    MonthDays *m = find_month(key);
+    if (m) return m;
+    if ((di->used + 1) * 2 > di->capacity) {
+        size_t capacity = di->capacity ? di->capacity * 2 : 256;
+        MonthDays *months = calloc(capacity, sizeof(MonthDays));
+        if (!months) return NULL;
+        for (size_t i = 0; i < di->capacity; i++) {
+            if (!di->months[i].key) continue;
+            size_t j = month_hash(di->months[i].key, capacity);
+            while (months[j].key) j = (j + 1) & (capacity - 1);
+            months[j] = di->months[i];
+        }
+        free(di->months);
+        di->months = months;
+        di->capacity = capacity;
+    }
+    size_t i = month_hash(key, di->capacity);
+    while (di->months[i].key) i = (i + 1) & (di->capacity - 1);
+    di->months[i].key = key;
+    di->used++;
+    return &di->months[i];
+}
+
+static void drop_day_index(void) {
+    free(table.days.months);
+    memset(&table.days, 0, sizeof(table.days));
+}
+
+// Counts one-off events; series are expanded per month on demand
+static void day_index_count(const Event *e, int delta) {
+    if (e->repeat) return;
+    int key = month_key(e->date.year, e->date.month);
+    if (!key || e->date.day < 1 || e->date.day > 31 || (unsigned)e->priority > PRIORITY_CRITICAL) return;
+    MonthDays *m = delta > 0 ? get_month(key) : find_month(key);
+    if (!m) {
+        if (delta > 0) drop_day_index();
+        return;
+    }
+    int *count = &m->counts[e->date.day - 1][e->priority];
+    *count += delta;
+    m->total += delta;
+    int busy = 0;
+    for (int p = 0; p < 4; p++) busy |= m->counts[e->date.day - 1][p];
+    if (busy) m->busy |= 1u << (e->date.day - 1);
+    else m->busy &= ~(1u << (e->date.day - 1));
+}
+
+static void day_index_insert(int slot) {
+    if (table.days.built) day_index_count(slot_event(slot), 1);
+}
+
+static void day_index_remove(int slot) {
+    if (table.days.built) day_index_count(slot_event(slot), -1);
+}
+
+static int build_day_index(void) {
+    if (table.days.built) return 1;
+    table.days.built = 1;
+    for (int i = 0; i < table.order_count && table.days.built; i++) {
+        if (!slot_event(table.order[i])->deleted) day_index_insert(table.order[i]);
+    }
+    return table.days.built;
+}
+
+unsigned month_busy_days(int year, int month) {
+    if (!month_key(year, month) || !build_day_index()) return 0;
+    MonthDays *m = find_month(month_key(year, month));
+    unsigned busy = m ? m->busy : 0;
+    Date first = { 1, month, year };
+    int lo = date_to_days(first), hi = lo + days_in_month(month, year) - 1;
+    for (int i = 0; i < table.series_count; i++) {
+        const Event *e = slot_event(table.series[i]);
+        for (int k = occurrence_on_or_after(e, lo); k <= hi; k = occurrence_on_or_after(e, k + 1)) {
+            busy |= 1u << (k - lo);
+        }
+    }
+    return busy;
+}
+
+int day_event_count(Date d, int *max_priority) {
+    int total = 0;
+    if (max_priority) *max_priority = -1;
+    if (d.day < 1 || d.day > 31 || !build_day_index()) return 0;
+    MonthDays *m = find_month(month_key(d.year, d.month));
+    for (int p = 0; m && p < 4; p++) {
+        total += m->counts[d.day - 1][p];
+        if (m->counts[d.day - 1][p] && max_priority) *max_priority = p;
+    }
+    int key = date_to_days(d);
+    for (int i = 0; i < table.series_count; i++) {
+        const Event *e = slot_event(table.series[i]);
+        if (occurrence_on_or_after(e, key) != key) continue;
+        total++;
+        if (max_priority && (int)e->priority > *max_priority) *max_priority = e->priority;
+    }
+    return total;
+}
+
+// Parallel scans
+// Big passes over the table cut positions 0 .. n - 1 into chunks that the
+// calling thread and up to threads - 1 pool workers claim one at a time.
+// A chunk only writes output owned by its chunk number and the caller
+// merges those in chunk order, so results never depend on the thread
+// count or on which thread ran which chunk. Workers only read the store.
+#define SCAN_CHUNK 65536
+
+static int scan_thread_count(int threads) {
+    if (threads <= 0) threads = scan.threads_wanted;
+    if (threads <= 0) threads = cpu_count();
+    return threads > SCAN_MAX_THREADS ? SCAN_MAX_THREADS : threads;
+}
+
+void set_scan_threads(int threads) {
+    scan.threads_wanted = threads < 0 ? 0 : threads;
+}
+
+int scan_threads(void) {
+    return scan_thread_count(0);
+}
+
+// Called and returns with the monitor held
+static void claim_scan_chunks(void) {
+    while (scan.next < scan.chunks) {
+        int chunk = scan.next++;
+        int first = chunk * scan.chunk_size;
+        int end = scan.n - first > scan.chunk_size ? first + scan.chunk_size : scan.n;
+        ScanTask task = scan.task;
+        void *arg = scan.arg;
+        monitor_leave(scan.monitor);
+        task(chunk, first, end, arg);
+        monitor_enter(scan.monitor);
+        if (++scan.done == scan.chunks) monitor_notify_all(scan.monitor);
+    }
+}
+
+static void scan_worker(void *arg) {
+    (void)arg;
+    unsigned long seen = 0;
+    monitor_enter(scan.monitor);
+    for (;;) {
+        while (scan.job == seen && !scan.stopping) monitor_wait(scan.monitor);
+        if (scan.stopping) break;
+        seen = scan.job;
+        if (scan.joined >= scan.helpers) continue;
+        scan.joined++;
+        claim_scan_chunks();
+    }
+    monitor_leave(scan.monitor);
+}
+
+// Starts workers until `helpers` of them run; returns how many do
+static int start_scan_workers(int helpers) {
+    if (!scan.monitor && !(scan.monitor = monitor_create())) return 0;
+    while (scan.started < helpers) {
+        PlatformThread *t = thread_start(scan_worker, NULL);
+        if (!t) break;
+        scan.threads[scan.started++] = t;
+    }
+    return scan.started < helpers ? scan.started : helpers;
+}
+
+// Runs task over 0 .. n - 1 in chunks of chunk_size on up to threads
+// threads (0 = the set_scan_threads default) and returns once every chunk
+// is done. A scan started while another one runs stays on its own thread.
+static void run_scan(int n, int chunk_size, int threads, ScanTask task, void *arg) {
+    int chunks = n > 0 ? (n - 1) / chunk_size + 1 : 0;
+    int helpers = scan_thread_count(threads) - 1;
+    if (helpers > chunks - 1) helpers = chunks - 1;
+    if (helpers > 0) helpers = start_scan_workers(helpers);
+    if (helpers > 0) {
+        monitor_enter(scan.monitor);
+        if (scan.running) helpers = 0;
+        else scan.running = 1;
+        monitor_leave(scan.monitor);
+    }
+    if (helpers <= 0) {
+        for (int c = 0; c < chunks; c++) {
+            int first = c * chunk_size;
+            task(c, first, n - first > chunk_size ? first + chunk_size : n, arg);
+        }
+        return;
+    }
+
+    monitor_enter(scan.monitor);
+    scan.task = task;
+    scan.arg = arg;
+    scan.n = n;
+    scan.chunk_size = chunk_size;
+    scan.chunks = chunks;
+    scan.next = scan.done = 0;
+    scan.helpers = helpers;
+    scan.joined = 0;
+    scan.job++;
+    monitor_notify_all(scan.monitor);
+    claim_scan_chunks();
+    while (scan.done < scan.chunks) monitor_wait(scan.monitor);
+    scan.running = 0;
+    monitor_leave(scan.monitor);
+}
+
+void stop_scan_workers(void) {
+    if (!scan.monitor) return;
+    monitor_enter(scan.monitor);
+    scan.stopping = 1;
+    monitor_notify_all(scan.monitor);
+    monitor_leave(scan.monitor);
+    for (int i = 0; i < scan.started; i++) thread_join(scan.threads[i]);
+    monitor_destroy(scan.monitor);
+    scan.monitor = NULL;
+    scan.started = 0;
+    scan.stopping = 0;
+}
+
+// Statistics
+// Counters adjusted by every edit, so the dashboard never walks the
+// store; per-day figures come from the day index.
+static void stats_count(StatsIndex *st, const Event *e, int delta) {
+    int minutes = (e->end_time.hour - e->start_time.hour) * 60 + e->end_time.minute - e->start_time.minute;
+    st->total += delta;
+    if (e->is_all_day) st->all_day += delta;
+    if (e->reminder_minutes > 0) st->with_reminder += delta;
+    if (e->repeat) st->repeating += delta;
+    if ((unsigned)e->priority <= PRIORITY_CRITICAL) st->priorities[e->priority] += delta;
+    if ((unsigned)e->category <= CAT_OTHER) {
+        st->categories[e->category] += delta;
+        if (!e->is_all_day && minutes > 0) st->category_minutes[e->category] += (long long)delta * minutes;
+    }
+}
+
+static void stats_insert(int slot) {
+    if (table.stats.built) stats_count(&table.stats, slot_event(slot), 1);
+}
+
+static void stats_remove(int slot) {
+    if (table.stats.built) stats_count(&table.stats, slot_event(slot), -1);
+}
+
+static void drop_stats(void) {
+    memset(&table.stats, 0, sizeof(table.stats));
+}
+
+// Counts one chunk of `order` into its own StatsIndex
+static void count_stats_chunk(int chunk, int first, int end, void *arg) {
+    StatsIndex *st = (StatsIndex*)arg + chunk;
+    for (int i = first; i < end; i++) {
+        const Event *e = slot_event(table.order[i]);
+        if (!e->deleted) stats_count(st, e, 1);
+    }
+}
+
+static void build_stats(void) {
+    if (table.stats.built) return;
+    int chunks = table.order_count / SCAN_CHUNK + 1;
+    StatsIndex *parts = (StatsIndex*)calloc((size_t)chunks, sizeof(StatsIndex));
+    if (!parts) {
+        table.stats.built = 1;
+        for (int i = 0; i < table.order_count; i++) {
+            if (!slot_event(table.order[i])->deleted) stats_insert(table.order[i]);
+        }
+        return;
+    }
+    run_scan(table.order_count, SCAN_CHUNK, 0, count_stats_chunk, parts);
+    StatsIndex *st = &table.stats;
+    for (int c = 0; c < chunks; c++) {
+        st->total += parts[c].total;
+        st->all_day += parts[c].all_day;
+        st->with_reminder += parts[c].with_reminder;
+        st->repeating += parts[c].repeating;
+        for (int i = 0; i < 4; i++) st->priorities[i] += parts[c].priorities[i];
+        for (int i = 0; i < 8; i++) {
+            st->categories[i] += parts[c].categories[i];
+            st->category_minutes[i] += parts[c].category_minutes[i];
+        }
+    }
+    st->built = 1;
+    free(parts);
+}
+
+// Keeps busiest sorted by most events, then earliest date
+static void rank_busy_day(StatsIndex *st, Date d, int events) {
+    int i = st->busiest_count;
+    if (i == STATS_BUSIEST_DAYS) {
+        DayCount *last = &st->busiest[i - 1];
+        if (events < last->events || (events == last->events && compare_dates(d, last->date) > 0)) return;
+        i--;
+    } else {
+        st->busiest_count++;
+    }
+    while (i > 0 && (st->busiest[i - 1].events < events ||
+                     (st->busiest[i - 1].events == events && compare_dates(st->busiest[i - 1].date, d) > 0))) {
+        st->busiest[i] = st->busiest[i - 1];
+        i--;
+    }
+    st->busiest[i].date = d;
+    st->busiest[i].events = events;
+}
+
+// Walks the months from the first to the last one holding an event or a
+// series start, adding each series' occurrences to the one-off counts of
+// the day index. A series running on past the last such month (or
+// forever) is not counted beyond it.
+static int rank_busiest_days(void) {
+    StatsIndex *st = &table.stats;
+    int first = INT_MAX, last = 0;
+    st->busiest_count = 0;
+    if (!build_day_index()) return 0;
+    for (size_t i = 0; i < table.days.capacity; i++) {
+        const MonthDays *m = &table.days.months[i];
+        if (!m->key || !m->total) continue;
+        if (m->key < first) first = m->key;
+        if (m->key > last) last = m->key;
+    }
+    for (int i = 0; i < table.series_count; i++) {
+        const Event *e = slot_event(table.series[i]);
+        int key = month_key(e->date.year, e->date.month);
+        if (key && key < first) first = key;
+        if (key > last) last = key;
+    }
+    if (first > last) return 1;
+
+    int *next = (int*)malloc(((size_t)table.series_count + 1) * sizeof(int));
+    if (!next) return 0;
+    Date from = { 1, (first - 1) % 12 + 1, (first - 1) / 12 };
+    for (int i = 0; i < table.series_count; i++) {
+        next[i] = occurrence_on_or_after(slot_event(table.series[i]), date_to_days(from));
+    }
+    for (int key = first; key <= last; key++) {
+        int year = (key - 1) / 12, month = (key - 1) % 12 + 1, counts[31] = {0};
+        Date day_one = { 1, month, year };
+        int lo = date_to_days(day_one), end = lo + days_in_month(month, year);
+        const MonthDays *m = find_month(key);
+        unsigned busy = m ? m->busy : 0;
+        for (unsigned b = busy; b; b &= b - 1) {
+            int day = 0;
+            while (!(b >> day & 1)) day++;
+            counts[day] = m->counts[day][0] + m->counts[day][1] + m->counts[day][2] + m->counts[day][3];
+        }
+        for (int i = 0; i < table.series_count; i++) {
+            const Event *e = slot_event(table.series[i]);
+            for (; next[i] < end; next[i] = occurrence_on_or_after(e, next[i] + 1)) {
+                counts[next[i] - lo]++;
+                busy |= 1u << (next[i] - lo);
+            }
+        }
+        for (; busy; busy &= busy - 1) {
+            int day = 0;
+            while (!(busy >> day & 1)) day++;
+            Date d = { day + 1, month, year };
+            rank_busy_day(st, d, counts[day]);
+        }
+    }
+    free(next);
+    return 1;
+}
+
+void get_event_stats(EventStats *st) {
+    build_stats();
+    memset(st, 0, sizeof(*st));
+    st->total = table.stats.total;
+    st->all_day = table.stats.all_day;
+    st->with_reminder = table.stats.with_reminder;
+    st->repeating = table.stats.repeating;
+    memcpy(st->priorities, table.stats.priorities, sizeof(st->priorities));
+    memcpy(st->categories, table.stats.categories, sizeof(st->categories));
+    memcpy(st->category_minutes, table.stats.category_minutes, sizeof(st->category_minutes));
+
+    // Ranked once per change to the store, so repeated reads are free
+    StatsIndex *cache = &table.stats;
+    if (!cache->busiest_ranked || cache->busiest_version != store_changes) {
+        cache->busiest_ranked = rank_busiest_days();
+        cache->busiest_version = store_changes;
+    }
+    memcpy(st->busiest, cache->busiest, sizeof(st->busiest));
+    st->busiest_count = cache->busiest_count;
+}
+
+void month_histogram(int year, int month, int months, int *counts) {
+    int key = month_key(year, month);
+    int built = key && build_day_index();
+    for (int i = 0; i < months; i++) {
+        const MonthDays *m = built ? find_month(key + i) : NULL;
+        counts[i] = m ? m->total : 0;
+    }
+    if (!built || months <= 0) return;
+
+    // Series occurrences, stepping a month boundary at a time
+    int last = key + months - 1;
+    Date from = { 1, month, year }, to = { 1, (last - 1) % 12 + 1, (last - 1) / 12 };
+    to.day = days_in_month(to.month, to.year);
+    int lo = date_to_days(from), hi = date_to_days(to);
+    for (int s = 0; s < table.series_count; s++) {
+        const Event *e = slot_event(table.series[s]);
+        int i = 0, month_end = lo + days_in_month(month, year);
+        for (int k = occurrence_on_or_after(e, lo); k <= hi; k = occurrence_on_or_after(e, k + 1)) {
+            while (k >= month_end) {
+                i++;
+                month_end += days_in_month((key + i - 1) % 12 + 1, (key + i - 1) / 12);
+            }
+            counts[i]++;
+        }
+    }
+}
+
+// Interval tree
+// One-off events as [start, end) minute intervals in a treap ordered like
+// `order`, so starts never decrease in order, and each node keeps the
+// latest end in its subtree. An overlap query skips every subtree that
+// ends too early and stops at the first start past the window. Nodes are
+// indexed by slot; a node's heap priority is a hash of its slot. Series
+// are expanded per query instead, as in the day index.
+static void time_span(int key, int all_day, Time start, Time end, long long *from, long long *to) {
+    long long day = (long long)key * 1440;
+    if (all_day) {
+        *from = day;
+        *to = day + 1440;
+        return;
+    }
+    *from = day + start.hour * 60 + start.minute;
+    *to = day + end.hour * 60 + end.minute;
+    // An event that does not end after it starts still takes its first minute
+    if (*to <= *from) *to = *from + 1;
+}
+
+static void occurrence_span(const Event *e, int key, long long *from, long long *to) {
+    time_span(key, e->is_all_day, e->start_time, e->end_time, from, to);
+}
+
+static unsigned node_priority(int slot) {
+    unsigned x = (unsigned)slot * 0x9E3779B1u;
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    return x ^ (x >> 16);
+}
+
+static void drop_interval_tree(void) {
+    free(table.intervals.nodes);
+    free(table.intervals.hits);
+    memset(&table.intervals, 0, sizeof(table.intervals));
+    table.intervals.root = -1;
+}
+
+static void update_max_end(int t) {
+    IntervalNode *n = &table.intervals.nodes[t];
+    n->max_end = n->end;
+    if (n->left >= 0 && table.intervals.nodes[n->left].max_end > n->max_end) {
+        n->max_end = table.intervals.nodes[n->left].max_end;
+    }
+    if (n->right >= 0 && table.intervals.nodes[n->right].max_end > n->max_end) {
+        n->max_end = table.intervals.nodes[n->right].max_end;
+    }
+}
+
+// Splits subtree t into the nodes ordered before slot and the rest
+static void split_intervals(int t, const Event *e, int *left, int *right) {
+    if (t < 0) {
+        *left = *right = -1;
+        return;
+    }
+    IntervalNode *n = &table.intervals.nodes[t];
+    if (event_cmp(slot_event(t), e) < 0) {
+        split_intervals(n->right, e, &n->right, right);
+        *left = t;
+    } else {
+        split_intervals(n->left, e, left, &n->left);
+        *right = t;
+    }
+    update_max_end(t);
+}
+
+static int merge_intervals(int left, int right) {
+    if (left < 0) return right;
+    if (right < 0) return left;
+    IntervalNode *nodes = table.intervals.nodes;
+    if (node_priority(left) > node_priority(right)) {
+        nodes[left].right = merge_intervals(nodes[left].right, right);
+        update_max_end(left);
+        return left;
+    }
+    nodes[right].left = merge_intervals(left, nodes[right].left);
+    update_max_end(right);
+    return right;
+}
+
+static int insert_interval(int t, int slot) {
+    IntervalNode *nodes = table.intervals.nodes;
+    if (t < 0) return slot;
+    if (node_priority(slot) > node_priority(t)) {
+        split_intervals(t, slot_event(slot), &nodes[slot].left, &nodes[slot].right);
+        update_max_end(slot);
+        return slot;
+    }
+    if (event_cmp(slot_event(slot), slot_event(t)) < 0) nodes[t].left = insert_interval(nodes[t].left, slot);
+    else nodes[t].right = insert_interval(nodes[t].right, slot);
+    update_max_end(t);
+    return t;
+}
+
+static int erase_interval(int t, int slot) {
+    IntervalNode *nodes = table.intervals.nodes;
+    if (t < 0) return -1;
+    if (t == slot) return merge_intervals(nodes[t].left, nodes[t].right);
+    if (event_cmp(slot_event(slot), slot_event(t)) < 0) nodes[t].left = erase_interval(nodes[t].left, slot);
+    else nodes[t].right = erase_interval(nodes[t].right, slot);
+    update_max_end(t);
+    return t;
+}
+
+static void set_interval_node(int slot) {
+    IntervalNode *n = &table.intervals.nodes[slot];
+    const Event *e = slot_event(slot);
+    occurrence_span(e, e->date_key, &n->start, &n->end);
+    n->max_end = n->end;
+    n->left = n->right = -1;
+}
+
+static void interval_tree_insert(int slot) {
+    IntervalTree *it = &table.intervals;
+    if (!it->built || slot_event(slot)->repeat) return;
+    if (!grow_array((void**)&it->nodes, &it->capacity, slot + 1, sizeof(IntervalNode))) {
+        drop_interval_tree();
+        return;
+    }
+    set_interval_node(slot);
+    it->root = insert_interval(it->root, slot);
+}
+
+static void interval_tree_remove(int slot) {
+    if (!table.intervals.built || slot_event(slot)->repeat) return;
+    table.intervals.root = erase_interval(table.intervals.root, slot);
+}
+
+static void fix_max_ends(int t) {
+    if (t < 0) return;
+    fix_max_ends(table.intervals.nodes[t].left);
+    fix_max_ends(table.intervals.nodes[t].right);
+    update_max_end(t);
+}
+
+// `order` is already sorted, so the treap is built in O(n) with a stack
+// holding its right spine
+static int build_interval_tree(void) {
+    IntervalTree *it = &table.intervals;
+    if (it->built) return 1;
+    drop_interval_tree();
+    int *spine = (int*)malloc(((size_t)table.order_count + 1) * sizeof(int));
+    if (!spine || !grow_array((void**)&it->nodes, &it->capacity, table.arena.used + 1, sizeof(IntervalNode))) {
+        free(spine);
+        drop_interval_tree();
+        return 0;
+    }
+    int top = 0;
+    for (int i = 0; i < table.order_count; i++) {
+        int slot = table.order[i];
+        const Event *e = slot_event(slot);
+        if (e->deleted || e->repeat) continue;
+        set_interval_node(slot);
+        int last = -1;
+        while (top > 0 && node_priority(spine[top - 1]) < node_priority(slot)) last = spine[--top];
+        it->nodes[slot].left = last;
+        if (top > 0) it->nodes[spine[top - 1]].right = slot;
+        spine[top++] = slot;
+    }
+    it->root = top > 0 ? spine[0] : -1;
+    free(spine);
+    fix_max_ends(it->root);
+    it->built = 1;
+    return 1;
+}
+
+static void add_interval_hit(int slot) {
+    IntervalTree *it = &table.intervals;
+    if (grow_array((void**)&it->hits, &it->hit_capacity, it->hit_count + 1, sizeof(int))) {
+        it->hits[it->hit_count++] = slot;
+    }
+}
+
+static void collect_overlaps(int t, long long from, long long to) {
+    const IntervalNode *nodes = table.intervals.nodes;
+    while (t >= 0 && nodes[t].max_end > from) {
+        collect_overlaps(nodes[t].left, from, to);
+        if (nodes[t].start >= to) return;
+        if (nodes[t].end > from) add_interval_hit(t);
+        t = nodes[t].right;
+    }
+}
+
+// Slots of the one-off events overlapping [from, to), in date order, in
+// table.intervals.hits; returns their count
+static int tree_overlaps(long long from, long long to) {
+    table.intervals.hit_count = 0;
+    collect_overlaps(table.intervals.root, from, to);
+    return table.intervals.hit_count;
+}
+
+static long long overlap_minutes(long long a_from, long long a_to, long long b_from, long long b_to) {
+    return (a_to < b_to ? a_to : b_to) - (a_from > b_from ? a_from : b_from);
+}
+
+int find_overlaps(Date d, Time start, Time end, int all_day, int exclude_id, int *ids, int max) {
+    if (!build_interval_tree()) return -1;
+    int key = date_to_days(d), found = 0;
+    long long from, to;
+    time_span(key, all_day, start, end, &from, &to);
+    int hits = tree_overlaps(from, to);
+    for (int i = 0; i < hits; i++) {
+        int id = slot_event(table.intervals.hits[i])->id;
+        if (id == exclude_id) continue;
+        if (found < max) ids[found] = id;
+        found++;
+    }
+    for (int i = 0; i < table.series_count; i++) {
+        const Event *e = slot_event(table.series[i]);
+        long long s_from, s_to;
+        if (e->id == exclude_id || occurrence_on_or_after(e, key) != key) continue;
+        occurrence_span(e, key, &s_from, &s_to);
+        if (s_from >= to || s_to <= from) continue;
+        if (found < max) ids[found] = e->id;
+        found++;
+    }
+    return found;
+}
+
+int find_series_overlaps(Date d, Time start, Time end, int all_day, const Recurrence *rule,
+                         int days, int exclude_id, int *ids, int max) {
+    Recurrence r = { 0 };
+    Event e = { 0 };
+    e.date = d;
+    e.date_key = date_to_days(d);
+    if (rule && rule->frequency != REPEAT_NONE) {
+        if (!rule_valid(rule)) return -1;
+        r = *rule;
+        e.repeat = &r;
+        r.last_key = series_last_key(&e);
+    }
+    int *hits = NULL, hit_capacity = 0, *seen = NULL, seen_capacity = 0, found = 0;
+    long long horizon = (long long)e.date_key + (days > 1 ? days : 1);
+    for (int key = occurrence_on_or_after(&e, e.date_key); key != NO_OCCURRENCE && key < horizon;
+         key = occurrence_on_or_after(&e, key + 1)) {
+        Date day = days_to_date(key);
+        int n = find_overlaps(day, start, end, all_day, exclude_id, hits, hit_capacity);
+        if (n > hit_capacity) {
+            if (!grow_array((void**)&hits, &hit_capacity, n, sizeof(int))) n = -1;
+            else n = find_overlaps(day, start, end, all_day, exclude_id, hits, hit_capacity);
+        }
+        if (n < 0) {
+            found = -1;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int j = 0;
+            while (j < found && seen[j] != hits[i]) j++;
+            if (j < found) continue;
+            if (!grow_array((void**)&seen, &seen_capacity, found + 1, sizeof(int))) {
+                found = -1;
+                break;
+            }
+            if (found < max) ids[found] = hits[i];
+            seen[found++] = hits[i];
+        }
+        if (found < 0) break;
+    }
+    free(hits);
+    free(seen);
+    return found;
+}
+
+// Conflict of the events at slots a and b on day key, earlier start first
+static int add_conflict(EventConflict **out, int *count, int *capacity, int key,
+                        int a, long long a_from, long long a_to, int b, long long b_from, long long b_to) {
+    if (!grow_array((void**)out, capacity, *count + 1, sizeof(EventConflict))) return 0;
+    EventConflict *c = &(*out)[(*count)++];
+    int a_first = a_from < b_from || (a_from == b_from && slot_event(a)->id < slot_event(b)->id);
+    long long start = a_from > b_from ? a_from : b_from;
+    c->date = days_to_date(key);
+    c->first = slot_event(a_first ? a : b)->id;
+    c->second = slot_event(a_first ? b : a)->id;
+    c->start.hour = (int)(start - (long long)key * 1440) / 60;
+    c->start.minute = (int)(start - (long long)key * 1440) % 60;
+    c->minutes = (int)overlap_minutes(a_from, a_to, b_from, b_to);
+    return 1;
+}
+
+static int conflict_cmp(const void *a, const void *b) {
+    const EventConflict *x = (const EventConflict*)a, *y = (const EventConflict*)b;
+    int sx = x->start.hour * 60 + x->start.minute, sy = y->start.hour * 60 + y->start.minute;
+    if (sx != sy) return sx - sy;
+    if (x->first != y->first) return x->first - y->first;
+    return x->second - y->second;
+}
+
+// Series occurrence on the day being reported, or a busy span
+typedef struct {
+    int slot;
+    long long from, to;
+} SeriesSpan;
+
+int find_conflicts(Date from, Date to, EventConflict *out, int max) {
+    if (!build_interval_tree()) return -1;
+    int lo = date_to_days(from), hi = date_to_days(to);
+    int *next = (int*)malloc(((size_t)table.series_count + 1) * sizeof(int));
+    SeriesSpan *spans = (SeriesSpan*)malloc(((size_t)table.series_count + 1) * sizeof(SeriesSpan));
+    EventConflict *day = NULL;
+    int day_capacity = 0, written = 0, pos, ok = next && spans;
+    for (int i = 0; ok && i < table.series_count; i++) next[i] = occurrence_on_or_after(slot_event(table.series[i]), lo);
+    event_range(from, from, &pos);
+
+    // One day at a time, so the report stays in date order and can stop
+    // as soon as max conflicts are written
+    for (int key = lo; ok && key <= hi && written < max; key++) {
+        int count = 0, span_count = 0;
+        for (; pos < table.order_count && slot_event(table.order[pos])->date_key == key; pos++) {
+            int slot = table.order[pos];
+            const Event *e = slot_event(slot);
+            long long e_from, e_to;
+            if (e->deleted || e->repeat) continue;
+            occurrence_span(e, key, &e_from, &e_to);
+            int hits = tree_overlaps(e_from, e_to);
+            for (int h = 0; ok && h < hits; h++) {
+                int other = table.intervals.hits[h];
+                if (event_cmp(e, slot_event(other)) >= 0) continue;   // reported from its side
+                const IntervalNode *n = &table.intervals.nodes[other];
+                ok = add_conflict(&day, &count, &day_capacity, key, slot, e_from, e_to, other, n->start, n->end);
+            }
+        }
+        for (int i = 0; ok && i < table.series_count; i++) {
+            if (next[i] != key) continue;
+            int slot = table.series[i];
+            const Event *e = slot_event(slot);
+            SeriesSpan *s = &spans[span_count++];
+            s->slot = slot;
+            occurrence_span(e, key, &s->from, &s->to);
+            next[i] = key < INT_MAX - 1 ? occurrence_on_or_after(e, key + 1) : NO_OCCURRENCE;
+            int hits = tree_overlaps(s->from, s->to);
+            for (int h = 0; ok && h < hits; h++) {
+                const IntervalNode *n = &table.intervals.nodes[table.intervals.hits[h]];
+                ok = add_conflict(&day, &count, &day_capacity, key, slot, s->from, s->to,
+                                  table.intervals.hits[h], n->start, n->end);
+            }
+            for (int j = 0; ok && j < span_count - 1; j++) {
+                if (spans[j].from < s->to && s->from < spans[j].to) {
+                    ok = add_conflict(&day, &count, &day_capacity, key, spans[j].slot, spans[j].from,
+                                      spans[j].to, slot, s->from, s->to);
+                }
+            }
+        }
+        if (count > 1) qsort(day, count, sizeof(EventConflict), conflict_cmp);
+        for (int i = 0; i < count && written < max; i++) out[written++] = day[i];
+    }
+    free(next);
+    free(spans);
+    free(day);
+    return ok ? written : -1;
+}
+
+// Free time: per day, the busy intervals inside the working hours come
+// from the interval tree already sorted by start, series occurrences are
+// merged in, and one sweep yields the gaps between them.
+static int add_busy_span(SeriesSpan **spans, int *count, int *capacity, int slot, long long from, long long to) {
+    if (!grow_array((void**)spans, capacity, *count + 1, sizeof(SeriesSpan))) return 0;
+    SeriesSpan *s = &(*spans)[(*count)++];
+    s->slot = slot;
+    s->from = from;
+    s->to = to;
+    return 1;
+}
+
+static int span_cmp(const void *a, const void *b) {
+    const SeriesSpan *x = (const SeriesSpan*)a, *y = (const SeriesSpan*)b;
+    return x->from < y->from ? -1 : x->from > y->from;
+}
+
+static void set_free_slot(FreeSlot *slot, int key, long long from, long long to) {
+    long long day = (long long)key * 1440;
+    slot->date = days_to_date(key);
+    slot->start.hour = (int)((from - day) / 60);
+    slot->start.minute = (int)((from - day) % 60);
+    slot->end.hour = (int)((to - day) / 60);
+    slot->end.minute = (int)((to - day) % 60);
+}
+
+int find_free_slots(const SlotQuery *q, FreeSlot *out, int max) {
+    int day_from = q->day_start.hour * 60 + q->day_start.minute;
+    int day_to = q->day_end.hour * 60 + q->day_end.minute;
+    if (q->minutes < 1 || day_from < 0 || day_to > 1440 || day_to - day_from < q->minutes ||
+        q->day_start.minute < 0 || q->day_start.minute > 59 ||
+        q->day_end.minute < 0 || q->day_end.minute > 59) return -1;
+    if (!build_interval_tree()) return -1;
+
+    int lo = date_to_days(q->from), hi = date_to_days(q->to);
+    int *next = (int*)malloc(((size_t)table.series_count + 1) * sizeof(int));
+    SeriesSpan *busy = NULL;
+    int busy_capacity = 0, written = 0, ok = next != NULL;
+    for (int i = 0; ok && i < table.series_count; i++) next[i] = occurrence_on_or_after(slot_event(table.series[i]), lo);
+
+    for (int key = lo; ok && key <= hi && written < max; key++) {
+        int busy_count = 0;
+        long long day = (long long)key * 1440;
+        long long from = day + day_from, to = day + day_to;
+        if (q->not_before && q->not_before > from) from = q->not_before;
+
+        // Series still have to step past this day even if it is skipped
+        for (int i = 0; ok && i < table.series_count; i++) {
+            if (next[i] != key) continue;
+            const Event *e = slot_event(table.series[i]);
+            long long s_from, s_to;
+            next[i] = key < INT_MAX - 1 ? occurrence_on_or_after(e, key + 1) : NO_OCCURRENCE;
+            if (q->ignore_categories >> e->category & 1) continue;
+            occurrence_span(e, key, &s_from, &s_to);
+            if (s_from < to && s_to > from) {
+                ok = add_busy_span(&busy, &busy_count, &busy_capacity, table.series[i], s_from, s_to);
+            }
+        }
+        if (from > to - q->minutes) continue;
+        if (q->weekdays && !(q->weekdays >> day_of_week(days_to_date(key)) & 1)) continue;
+
+        int series_spans = busy_count;
+        int hits = tree_overlaps(from, to);
+        for (int h = 0; ok && h < hits; h++) {
+            int slot = table.intervals.hits[h];
+            if (q->ignore_categories >> slot_event(slot)->category & 1) continue;
+            const IntervalNode *n = &table.intervals.nodes[slot];
+            ok = add_busy_span(&busy, &busy_count, &busy_capacity, slot, n->start, n->end);
+        }
+        if (!ok) break;
+        // Tree hits come sorted; only series spans can be out of place
+        if (series_spans > 0 && busy_count > 1) qsort(busy, busy_count, sizeof(SeriesSpan), span_cmp);
+
+        long long cursor = from;
+        for (int i = 0; i < busy_count && cursor < to && written < max; i++) {
+            if (busy[i].from - cursor >= q->minutes) set_free_slot(&out[written++], key, cursor, busy[i].from);
+            if (busy[i].to > cursor) cursor = busy[i].to;
+        }
+        if (written < max && to - cursor >= q->minutes) set_free_slot(&out[written++], key, cursor, to);
+    }
+    free(next);
+    free(busy);
+    return ok ? written : -1;
+}
+
+// Reminder heap
+// Every live event with a reminder is queued by the minute it is due, so
+// the next deadline is the root and nothing ever scans the store for it.
+static void drop_reminder_heap(void) {
+    free(table.reminders.items);
+    free(table.reminders.pos);
+    memset(&table.reminders, 0, sizeof(table.reminders));
+}
+
+static void reminder_place(int i, ReminderEntry entry) {
+    table.reminders.items[i] = entry;
+    table.reminders.pos[entry.slot] = i;
+}
+
+static void reminder_sift_up(int i) {
+    ReminderHeap *rh = &table.reminders;
+    ReminderEntry entry = rh->items[i];
+    while (i > 0 && rh->items[(i - 1) / 2].due > entry.due) {
+        reminder_place(i, rh->items[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    reminder_place(i, entry);
+}
+
+static void reminder_sift_down(int i) {
+    ReminderHeap *rh = &table.reminders;
+    ReminderEntry entry = rh->items[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= rh->count) break;
+        if (child + 1 < rh->count && rh->items[child + 1].due < rh->items[child].due) child++;
+        if (rh->items[child].due >= entry.due) break;
+        reminder_place(i, rh->items[child]);
+        i = child;
+    }
+    reminder_place(i, entry);
+}
+
+// First occurrence on or after key whose reminder is due after minute
+// `after`; LLONG_MIN accepts any
+static int reminder_occurrence(const Event *e, int key, long long after) {
+    if (after != LLONG_MIN) {
+        long long time_of_day = occurrence_start_minute(e, 0);
+        long long first = floor_div(after + e->reminder_minutes - time_of_day, 1440) + 1;
+        if (first > INT_MAX / 2) return NO_OCCURRENCE;
+        if (first > key) key = (int)first;
+    }
+    return occurrence_on_or_after(e, key);
+}
+
+// Appends the reminder for one occurrence without restoring heap order
+static int reminder_append(int slot, int key) {
+    ReminderHeap *rh = &table.reminders;
+    const Event *e = slot_event(slot);
+    int old = rh->pos_capacity;
+    if (!grow_array((void**)&rh->pos, &rh->pos_capacity, slot + 1, sizeof(int))) return 0;
+    for (int i = old; i < rh->pos_capacity; i++) rh->pos[i] = -1;
+    if (!grow_array((void**)&rh->items, &rh->capacity, rh->count + 1, sizeof(ReminderEntry))) return 0;
+    ReminderEntry entry = { occurrence_start_minute(e, key) - e->reminder_minutes, slot, key };
+    reminder_place(rh->count++, entry);
+    return 1;
+}
+
+static int reminder_push(int slot, int key) {
+    if (!reminder_append(slot, key)) {
+        drop_reminder_heap();
+        return 0;
+    }
+    reminder_sift_up(table.reminders.count - 1);
+    return 1;
+}
+
+static void reminder_heap_insert(int slot) {
+    const Event *e = slot_event(slot);
+    if (!table.reminders.built || e->reminder_minutes <= 0) return;
+    // Skip occurrences that had started by the last pop. A later one is
+    // still queued if its reminder time has passed, and fires at once.
+    long long after = reminders_delivered == LLONG_MIN ? LLONG_MIN
+                                                       : reminders_delivered - e->reminder_minutes;
+    int key = reminder_occurrence(e, e->date_key, after);
+    if (key != NO_OCCURRENCE) reminder_push(slot, key);
+}
+
+static void reminder_remove_at(int i) {
+    ReminderHeap *rh = &table.reminders;
+    rh->pos[rh->items[i].slot] = -1;
+    if (--rh->count == i) return;
+    reminder_place(i, rh->items[rh->count]);
+    if (i > 0 && rh->items[(i - 1) / 2].due > rh->items[i].due) reminder_sift_up(i);
+    else reminder_sift_down(i);
+}
+
+static void reminder_heap_remove(int slot) {
+    ReminderHeap *rh = &table.reminders;
+    if (!rh->built || slot >= rh->pos_capacity || rh->pos[slot] < 0) return;
+    reminder_remove_at(rh->pos[slot]);
+}
+
+// Queues every reminder not yet delivered, then heapifies in O(n)
+static int build_reminder_heap(void) {
+    ReminderHeap *rh = &table.reminders;
+    if (rh->built) return 1;
+    for (int i = 0; i < table.order_count; i++) {
+        const Event *e = slot_event(table.order[i]);
+        if (e->deleted || e->reminder_minutes <= 0) continue;
+        int key = reminder_occurrence(e, e->date_key, reminders_delivered);
+        if (key == NO_OCCURRENCE) continue;
+        if (!reminder_append(table.order[i], key)) {
+            drop_reminder_heap();
+            return 0;
+        }
+    }
+    for (int i = rh->count / 2 - 1; i >= 0; i--) reminder_sift_down(i);
+    rh->built = 1;
+    return 1;
+}
+
+int pending_reminders(void) {
+    return build_reminder_heap() ? table.reminders.count : 0;
+}
+
+int next_reminder_due(long long *due) {
+    if (!build_reminder_heap() || table.reminders.count == 0) return 0;
+    *due = table.reminders.items[0].due;
+    return 1;
+}
+
+int pop_due_reminders(long long now, int *ids, int max) {
+    ReminderHeap *rh = &table.reminders;
+    int n = 0;
+    if (!build_reminder_heap()) return 0;
+    while (n < max && rh->count > 0 && rh->items[0].due <= now) {
+        ReminderEntry top = rh->items[0];
+        const Event *e = slot_event(top.slot);
+        reminder_remove_at(0);
+        // Reminders for events that already began are dropped unseen
+        if (now < occurrence_start_minute(e, top.key)) ids[n++] = e->id;
+        if (e->repeat) {
+            // Queue the series' next occurrence that has not started yet
+            int key = reminder_occurrence(e, top.key + 1, now - e->reminder_minutes);
+            if (key != NO_OCCURRENCE && !reminder_push(top.slot, key)) break;
+        }
+    }
+    if (!rh->built) return n;
+    if (rh->count == 0 || rh->items[0].due > now) {
+        if (now > reminders_delivered) reminders_delivered = now;
+    }
+    return n;
+}
+
+// Secondary indexes follow every change to a live event
+static void indexes_insert(int slot) {
+    sort_indexes_insert(slot);
+    search_index_insert(slot);
+    day_index_insert(slot);
+    reminder_heap_insert(slot);
+    stats_insert(slot);
+    interval_tree_insert(slot);
+}
+
+static void indexes_remove(int slot) {
+    sort_indexes_remove(slot);
+    search_index_remove(slot);
+    day_index_remove(slot);
+    reminder_heap_remove(slot);
+    stats_remove(slot);
+    interval_tree_remove(slot);
+}
+
+static void drop_indexes(void) {
+    drop_sort_indexes();
+    drop_search_index();
+    drop_day_index();
+    drop_reminder_heap();
+    drop_stats();
+    drop_columns();
+    drop_interval_tree();
+}
+
+// Hands out a slot without touching `order`, reusing freed slots first
+static int alloc_slot(void) {
+    int slot = table.free_count > 0 ? table.free_slots[--table.free_count] : arena_alloc(&table.arena);
+    if (slot >= 0) slot_event(slot)->repeat = NULL;
+    return slot;
+}
+
+// Only called for slots that are no longer referenced from `order`
+static void release_slot(int slot) {
+    if (grow_array((void**)&table.free_slots, &table.free_capacity,
+                   table.free_count + 1, sizeof(int))) {
+        table.free_slots[table.free_count++] = slot;
+    }
+}
+
+// Drops tombstones from `order` and recycles their slots
+void compact_events(void) {
+    if (table.dead_count == 0) return;
+    int w = 0;
+    for (int r = 0; r < table.order_count; r++) {
+        int slot = table.order[r];
+        if (slot_event(slot)->deleted) {
+            release_slot(slot);
+            continue;
+        }
+        if (table.columns.built && w != r) {
+            table.columns.day[w] = table.columns.day[r];
+            table.columns.priority[w] = table.columns.priority[r];
+            table.columns.category[w] = table.columns.category[r];
+            table.columns.dead[w] = 0;
+        }
+        table.order[w++] = slot;
+    }
+    table.order_count = w;
+    table.dead_count = 0;
+    table.compactions++;
+}
+
+static void maybe_compact(void) {
+    if (bulk_mode || table.dead_count < COMPACT_MIN_DEAD) return;
+    if ((long long)table.dead_count * 100 >= (long long)table.order_count * COMPACT_DEAD_PERCENT) {
+        compact_events();
+    }
+}
+
+static size_t event_text_bytes(const Event *e) {
+    return strlen(e->description) + strlen(e->location);
+}
+
+// Re-interns the text of every live event into a fresh pool
+static void rebuild_string_pool(void) {
+    StringPool fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    for (int i = 0; i < table.order_count; i++) {
+        Event *e = slot_event(table.order[i]);
+        if (e->deleted) continue;
+        const char *desc = pool_intern(&fresh, e->description);
+        const char *loc = pool_intern(&fresh, e->location);
+        if (!desc || !loc) {
+            pool_free(&fresh);
+            return;
+        }
+        e->description = desc;
+        e->location = loc;
+    }
+    fresh.live_bytes = table.strings.live_bytes;
+    pool_free(&table.strings);
+    table.strings = fresh;
+}
+
+static void maybe_rebuild_string_pool(void) {
+    StringPool *sp = &table.strings;
+    if (bulk_mode || sp->bytes < POOL_MIN_REBUILD) return;
+    if (sp->bytes > 2 * (sp->live_bytes + (size_t)table.live_count * 2)) {
+        rebuild_string_pool();
+    }
+}
+
+static int set_event_fields(Event *e, Date date, Time start, Time end,
+                            const char *desc, const char *loc, Priority pri,
+                            Category cat, int all_day, int reminder) {
+    const char *d = pool_intern(&table.strings, desc);
+    const char *l = pool_intern(&table.strings, loc);
+    if (!d || !l) return 0;
+    e->date = date;
+    e->date_key = date_to_days(date);
+    e->start_time = start;
+    e->end_time = end;
+    e->description = d;
+    e->location = l;
+    e->priority = pri;
+    e->category = cat;
+    e->is_all_day = all_day;
+    e->reminder_minutes = reminder;
+    e->deleted = 0;
+    // count is measured from the first occurrence, so the end moves with it
+    if (e->repeat) ((Recurrence*)e->repeat)->last_key = series_last_key(e);
+    return 1;
+}
+
+// Event management
+// Places a new event under a caller-chosen id that must not be in use
+static Event* insert_event(int id, Date date, Time start, Time end, const char *desc,
+                           const char *loc, Priority pri, Category cat,
+                           int all_day, int reminder) {
+    if (!ensure_id_capacity(id)) return NULL;
+    int slot = alloc_slot();
+    if (slot < 0) return NULL;
+
+    Event *e = slot_event(slot);
+    // The id breaks ties in `order`, so it must be set before inserting
+    e->id = id;
+    if (!set_event_fields(e, date, start, end, desc, loc, pri, cat, all_day, reminder) ||
+        !order_insert(slot)) {
+        release_slot(slot);
+        return NULL;
+    }
+    if (id >= next_id) next_id = id + 1;
+    store_changes++;
+    table.id_slot[id] = slot;
+    table.live_count++;
+    table.strings.live_bytes += event_text_bytes(e);
+    indexes_insert(slot);
+    return e;
+}
+
+Event* add_event(Date date, Time start, Time end, const char *desc,
+                 const char *loc, Priority pri, Category cat,
+                 int all_day, int reminder) {
+    return insert_event(next_id, date, start, end, desc, loc, pri, cat, all_day, reminder);
+}
+
+Event* update_event(int id, Date date, Time start, Time end, const char *desc,
+                    const char *loc, Priority pri, Category cat,
+                    int all_day, int reminder) {
+    Event *e = find_event_by_id(id);
+    if (!e) return NULL;
+
+    int slot = table.id_slot[id];
+    size_t old_bytes = event_text_bytes(e);
+    store_changes++;
+    order_remove(slot);
+    indexes_remove(slot);
+    if (!set_event_fields(e, date, start, end, desc, loc, pri, cat, all_day, reminder)) {
+        order_insert(slot);
+        indexes_insert(slot);
+        return NULL;
+    }
+    order_insert(slot);
+    indexes_insert(slot);
+    table.strings.live_bytes -= old_bytes;
+    table.strings.live_bytes += event_text_bytes(e);
+    maybe_rebuild_string_pool();
+    return e;
+}
+
+Event* find_event_by_id(int id) {
+    if (id <= 0 || id >= table.id_capacity) return NULL;
+    int slot = table.id_slot[id];
+    if (slot < 0) return NULL;
+    return slot_event(slot);
+}
+
+void delete_event(int id) {
+    Event *e = find_event_by_id(id);
+    if (!e) return;
+    indexes_remove(table.id_slot[id]);
+    if (e->repeat) {
+        series_untrack(table.id_slot[id]);
+        release_rule(e);
+    }
+    store_changes++;
+    e->deleted = 1;
+    if (table.columns.built) {
+        int pos = order_position(table.id_slot[id]);
+        if (pos >= 0) table.columns.dead[pos] = 1;
+    }
+    table.id_slot[id] = -1;
+    table.live_count--;
+    table.dead_count++;
+    table.strings.live_bytes -= event_text_bytes(e);
+    maybe_compact();
+    maybe_rebuild_string_pool();
+}
+
+int has_events_on_date(Date d) {
+    return day_event_count(d, NULL) > 0;
+}
+
+int count_events(void) {
+    return table.live_count;
+}
+
+void get_store_stats(StoreStats *st) {
+    st->live = table.live_count;
+    st->dead = table.dead_count;
+    st->free_slots = table.free_count;
+    st->slots = table.arena.used;
+    st->compactions = table.compactions;
+    st->arena_chunks = table.arena.chunk_count;
+    st->arena_bytes_used = (size_t)(table.arena.used - table.free_count) * sizeof(Event);
+    st->arena_bytes_wasted = (size_t)table.arena.chunk_count * ARENA_CHUNK_EVENTS * sizeof(Event)
+                           - st->arena_bytes_used;
+    st->strings = (int)table.strings.hash_count;
+    st->string_bytes = table.strings.bytes;
+}
+
+void free_events(void) {
+    unmap_file(&mapped_file);
+    drop_indexes();
+    for (int i = 0; i < table.series_count; i++) release_rule(slot_event(table.series[i]));
+    free(table.series);
+    store_changes++;
+    arena_free(&table.arena);
+    pool_free(&table.strings);
+    free(table.order);
+    free(table.id_slot);
+    free(table.free_slots);
+    memset(&table, 0, sizeof(table));
+    reminders_delivered = LLONG_MIN;
+}
+
+void begin_bulk_insert(void) {
+    // Rebuilding on next use beats one incremental update per event
+    drop_indexes();
+    bulk_mode = 1;
+    bulk_sorted = 1;
+}
+
+void end_bulk_insert(void) {
+    if (!bulk_mode) return;
+    bulk_mode = 0;
+    store_changes++;
+    if (!bulk_sorted) {
+        qsort(table.order, table.order_count, sizeof(int), order_slot_cmp);
+    }
+    maybe_compact();
+    maybe_rebuild_string_pool();
+}
+
+int event_table_size(void) {
+    return table.order_count;
+}
+
+Event* event_at(int pos) {
+    return slot_event(table.order[pos]);
+}
+
+// First order position whose date key is at least key
+static int order_lower_bound_day(int key) {
+    int lo = 0, hi = table.order_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (slot_event(table.order[mid])->date_key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int first_event_on_or_after(Date d) {
+    return order_lower_bound_day(date_to_days(d));
+}
+
+int event_range(Date from, Date to, int *first) {
+    int lo = date_to_days(from), hi = date_to_days(to);
+    *first = order_lower_bound_day(lo);
+    if (hi < lo) return 0;
+    return order_lower_bound_day(hi + 1) - *first;
+}
+
+unsigned long store_version(void) {
+    return store_changes;
+}
+
+// Inclusive day-key bounds of a filter's date part; 0 if it has none
+static int filter_days(const EventFilter *f, int *lo, int *hi) {
+    if (!f->date) return 0;
+    *lo = date_to_days(*f->date);
+    *hi = f->date_to ? date_to_days(*f->date_to) : *lo;
+    return 1;
+}
+
+int filter_narrows(const EventFilter *narrow, const EventFilter *wide) {
+    int nlo, nhi, wlo, whi;
+    if (filter_days(wide, &wlo, &whi) &&
+        (!filter_days(narrow, &nlo, &nhi) || nlo < wlo || nhi > whi)) return 0;
+    if (wide->search && wide->search[0] &&
+        (!narrow->search || !contains_nocase(narrow->search, wide->search))) return 0;
+    if (wide->category != -1 && narrow->category != wide->category) return 0;
+    if (wide->priority != -1 && narrow->priority != wide->priority) return 0;
+    return 1;
+}
+
+int event_matches(const Event *e, const EventFilter *f) {
+    if (e->deleted) return 0;
+
+    // Apply date filter
+    int lo, hi;
+    if (filter_days(f, &lo, &hi) && occurrence_on_or_after(e, lo) > hi) {
+        return 0;
+    }
+
+    // Apply search filter
+    if (f->search && f->search[0]) {
+        if (!text_matches(e, f->search)) {
+            return 0;
+        }
+    }
+
+    // Apply category filter
+    if (f->category != -1 && (int)e->category != f->category) {
+        return 0;
+    }
+
+    // Apply priority filter
+    if (f->priority != -1 && (int)e->priority != f->priority) {
+        return 0;
+    }
+
+    return 1;
+}
+
+// Column filter
+// The date, category, priority and tombstone tests run over the filter
+// columns 32 positions at a time, each step producing one selection word.
+// Only a series' first date is in the columns, so series in the slice and
+// the text search are settled per candidate afterwards. The kernel is
+// picked on first use, as for the text matchers.
+typedef struct {
+    int lo, hi;              // inclusive day keys
+    int category, priority;  // -1 matches any
+} ColumnQuery;
+
+typedef void (*SelectKernel)(const ColumnQuery *q, int first, int words, unsigned *bits);
+
+static SelectKernel select_kernel;
+
+// Bit i set if position pos + i passes, for n <= 32 positions
+static unsigned select_word(const ColumnQuery *q, int pos, int n) {
+    const FilterColumns *c = &table.columns;
+    unsigned word = 0;
+    for (int i = 0; i < n; i++, pos++) {
+        if (c->dead[pos] || c->day[pos] < q->lo || c->day[pos] > q->hi) continue;
+        if (q->category != -1 && c->category[pos] != q->category) continue;
+        if (q->priority != -1 && c->priority[pos] != q->priority) continue;
+        word |= 1u << i;
+    }
+    return word;
+}
+
+static void select_scalar(const ColumnQuery *q, int first, int words, unsigned *bits) {
+    for (int w = 0; w < words; w++) bits[w] = select_word(q, first + w * 32, 32);
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("sse2")))
+static void select_sse2(const ColumnQuery *q, int first, int words, unsigned *bits) {
+    const FilterColumns *c = &table.columns;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_set1_epi32(q->lo), hi = _mm_set1_epi32(q->hi);
+    const __m128i cat = _mm_set1_epi8((char)q->category);
+    const __m128i pri = _mm_set1_epi8((char)q->priority);
+    const __m128i any_cat = _mm_set1_epi8(q->category == -1 ? -1 : 0);
+    const __m128i any_pri = _mm_set1_epi8(q->priority == -1 ? -1 : 0);
+    for (int w = 0; w < words; w++) {
+        int pos = first + w * 32;
+        unsigned word = 0, dates = 0;
+        for (int k = 0; k < 32; k += 16) {
+            __m128i keep = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(c->dead + pos + k)), zero);
+            keep = _mm_and_si128(keep, _mm_or_si128(any_cat,
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(c->category + pos + k)), cat)));
+            keep = _mm_and_si128(keep, _mm_or_si128(any_pri,
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(c->priority + pos + k)), pri)));
+            word |= (unsigned)_mm_movemask_epi8(keep) << k;
+        }
+        for (int k = 0; k < 32; k += 4) {
+            __m128i d = _mm_loadu_si128((const __m128i*)(c->day + pos + k));
+            __m128i out = _mm_or_si128(_mm_cmplt_epi32(d, lo), _mm_cmpgt_epi32(d, hi));
+            dates |= (unsigned)(~_mm_movemask_ps(_mm_castsi128_ps(out)) & 0xF) << k;
+        }
+        bits[w] = word & dates;
+    }
+}
+
+__attribute__((target("avx2")))
+static void select_avx2(const ColumnQuery *q, int first, int words, unsigned *bits) {
+    const FilterColumns *c = &table.columns;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lo = _mm256_set1_epi32(q->lo), hi = _mm256_set1_epi32(q->hi);
+    const __m256i cat = _mm256_set1_epi8((char)q->category);
+    const __m256i pri = _mm256_set1_epi8((char)q->priority);
+    const __m256i any_cat = _mm256_set1_epi8(q->category == -1 ? -1 : 0);
+    const __m256i any_pri = _mm256_set1_epi8(q->priority == -1 ? -1 : 0);
+    for (int w = 0; w < words; w++) {
+        int pos = first + w * 32;
+        __m256i keep = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(c->dead + pos)), zero);
+        keep = _mm256_and_si256(keep, _mm256_or_si256(any_cat,
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(c->category + pos)), cat)));
+        keep = _mm256_and_si256(keep, _mm256_or_si256(any_pri,
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(c->priority + pos)), pri)));
+        unsigned word = (unsigned)_mm256_movemask_epi8(keep), dates = 0;
+        for (int k = 0; k < 32; k += 8) {
+            __m256i d = _mm256_loadu_si256((const __m256i*)(c->day + pos + k));
+            __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(lo, d), _mm256_cmpgt_epi32(d, hi));
+            dates |= (unsigned)(~_mm256_movemask_ps(_mm256_castsi256_ps(out)) & 0xFF) << k;
+        }
+        bits[w] = word & dates;
+    }
+}
+#endif
+
+static void init_select_kernel(void) {
+    if (select_kernel) return;
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        select_kernel = select_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        select_kernel = select_sse2;
+        return;
+    }
+#endif
+    select_kernel = select_scalar;
+}
+
+static int lowest_bit(unsigned m) {
+    int b = 0;
+    while (!(m & 1)) {
+        m >>= 1;
+        b++;
+    }
+    return b;
+}
+
+typedef struct {
+    const EventFilter *f;
+    ColumnQuery q;
+    int first;
+    unsigned *bits;
+} SelectJob;
+
+// Scan chunks are whole words, so every chunk owns its part of bits
+static void select_chunk(int chunk, int first, int end, void *arg) {
+    SelectJob *job = (SelectJob*)arg;
+    unsigned *bits = job->bits + first / 32;
+    int n = end - first;
+    (void)chunk;
+    select_kernel(&job->q, job->first + first, n / 32, bits);
+    if (n % 32) bits[n / 32] = select_word(&job->q, job->first + first + n / 32 * 32, n % 32);
+}
+
+static void search_chunk(int chunk, int first, int end, void *arg) {
+    SelectJob *job = (SelectJob*)arg;
+    (void)chunk;
+    for (int w = first / 32; w < (end + 31) / 32; w++) {
+        for (unsigned m = job->bits[w]; m; m &= m - 1) {
+            int b = lowest_bit(m);
+            if (!text_matches(event_at(job->first + w * 32 + b), job->f->search)) {
+                job->bits[w] &= ~(1u << b);
+            }
+        }
+    }
+}
+
+int select_events(const EventFilter *f, int first, int count, unsigned *bits) {
+    if (count <= 0) return 0;
+    int words = (count + 31) / 32;
+    if (first < 0 || count > table.order_count - first) {
+        memset(bits, 0, (size_t)words * sizeof(unsigned));
+        return 0;
+    }
+
+    build_columns();
+    if (!table.columns.built) {
+        // Out of memory for the columns: test the events themselves
+        int matched = 0;
+        memset(bits, 0, (size_t)words * sizeof(unsigned));
+        for (int i = 0; i < count; i++) {
+            if (event_matches(event_at(first + i), f)) {
+                bits[i / 32] |= 1u << (i % 32);
+                matched++;
+            }
+        }
+        return matched;
+    }
+
+    SelectJob job = { f, { INT_MIN, INT_MAX, f->category, f->priority }, first, bits };
+    int dated = filter_days(f, &job.q.lo, &job.q.hi);
+    // Kernels are picked before any worker can race to do it
+    init_select_kernel();
+    init_text_match();
+    run_scan(count, SCAN_CHUNK, 0, select_chunk, &job);
+
+    // A series matches if any occurrence is in the range, not just the first
+    if (dated) {
+        EventFilter rest = *f;
+        rest.search = NULL;
+        for (int i = 0; i < table.series_count; i++) {
+            int pos = order_position(table.series[i]) - first;
+            if (pos < 0 || pos >= count) continue;
+            if (event_matches(slot_event(table.series[i]), &rest)) bits[pos / 32] |= 1u << (pos % 32);
+            else bits[pos / 32] &= ~(1u << (pos % 32));
+        }
+    }
+
+    if (f->search && f->search[0]) run_scan(count, SCAN_CHUNK, 0, search_chunk, &job);
+    int matched = 0;
+    for (int w = 0; w < words; w++) {
+        for (unsigned m = bits[w]; m; m &= m - 1) matched++;
+    }
+    return matched;
+}
+
+// File I/O
+// calendar.dat v4, all integers little-endian:
+//   header   u32 magic "CAL4", u16 version, u16 section count, u32 event count,
+//            u32 next id, u32 record size, u32 reserved
+//   sections section_count x {u32 kind, u32 entries, u64 offset, u64 size}
+//   records  fixed-width, in date order (see encode_record)
+//   strings  NUL-terminated text, offset 0 is the empty string
+//   series   optional {u32 id, rule (see encode_rule)} per recurring event
+// Readers skip section kinds they do not know and ignore any record bytes
+// past the fields they understand. Records already come in `order`, so no
+// day index is stored; earlier files carry one that is skipped.
+#define V4_MAGIC 0x344C4143u
+#define V4_VERSION 4
+#define V4_HEADER_SIZE 24
+#define V4_SECTION_SIZE 24
+#define V4_RECORD_SIZE 32
+#define V4_FLAG_ALL_DAY 1
+
+#define SECTION_RECORDS 1
+#define SECTION_STRINGS 2
+#define SECTION_DATE_INDEX 3     // no longer written
+#define SECTION_SERIES 4
+#define V4_SECTIONS 3
+
+// Recurrence rule: u8 frequency, u8 reserved, u16 interval, u32 count,
+// u32 packed until date (0 = none), u32 exception count, then one packed
+// date per exception
+#define RULE_HEADER_SIZE 16
+
+typedef struct {
+    unsigned char *data;
+    size_t size, capacity;
+} ByteBuf;
+
+static int buf_reserve(ByteBuf *b, size_t extra) {
+    if (b->size + extra <= b->capacity) return 1;
+    size_t cap = b->capacity ? b->capacity : 4096;
+    while (cap < b->size + extra) cap *= 2;
+    unsigned char *p = (unsigned char*)realloc(b->data, cap);
+    if (!p) return 0;
+    b->data = p;
+    b->capacity = cap;
+    return 1;
+}
+
+static void put_u16(unsigned char *p, unsigned v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_u32(unsigned char *p, unsigned long v) {
+    put_u16(p, (unsigned)(v & 0xFFFF));
+    put_u16(p + 2, (unsigned)((v >> 16) & 0xFFFF));
+}
+
+static void put_u64(unsigned char *p, unsigned long long v) {
+    put_u32(p, (unsigned long)(v & 0xFFFFFFFFu));
+    put_u32(p + 4, (unsigned long)(v >> 32));
+}
+
+static unsigned get_u16(const unsigned char *p) {
+    return (unsigned)p[0] | ((unsigned)p[1] << 8);
+}
+
+static unsigned long get_u32(const unsigned char *p) {
+    return (unsigned long)get_u16(p) | ((unsigned long)get_u16(p + 2) << 16);
+}
+
+static unsigned long long get_u64(const unsigned char *p) {
+    return (unsigned long long)get_u32(p) | ((unsigned long long)get_u32(p + 4) << 32);
+}
+
+static unsigned long pack_date(Date d) {
+    return ((unsigned long)d.year << 9) | ((unsigned long)d.month << 5) | (unsigned long)d.day;
+}
+
+static Date unpack_date(unsigned long v) {
+    Date d = { (int)(v & 31), (int)((v >> 5) & 15), (int)(v >> 9) };
+    return d;
+}
+
+static size_t rule_size(const Recurrence *r) {
+    return RULE_HEADER_SIZE + (size_t)r->exception_count * 4;
+}
+
+static void encode_rule(unsigned char *p, const Recurrence *r) {
+    p[0] = (unsigned char)r->frequency;
+    p[1] = 0;
+    put_u16(p + 2, (unsigned)r->interval);
+    put_u32(p + 4, (unsigned long)r->count);
+    put_u32(p + 8, r->until.year ? pack_date(r->until) : 0);
+    put_u32(p + 12, (unsigned long)r->exception_count);
+    for (int i = 0; i < r->exception_count; i++) {
+        put_u32(p + RULE_HEADER_SIZE + (size_t)i * 4, pack_date(days_to_date(r->exceptions[i])));
+    }
+}
+
+// Reads a rule into *r, its exceptions into a malloc'd *keys the caller
+// frees; returns the bytes used or 0 if the rule does not fit in len
+static size_t decode_rule(const unsigned char *p, size_t len, Recurrence *r, int **keys) {
+    *keys = NULL;
+    if (len < RULE_HEADER_SIZE) return 0;
+    unsigned long exceptions = get_u32(p + 12), until = get_u32(p + 8);
+    if (exceptions > MAX_REPEAT_EXCEPTIONS || (len - RULE_HEADER_SIZE) / 4 < exceptions) return 0;
+    memset(r, 0, sizeof(*r));
+    r->frequency = (RepeatFrequency)p[0];
+    r->interval = (int)get_u16(p + 2);
+    r->count = (int)(get_u32(p + 4) & 0x7FFFFFFF);
+    if (until) r->until = unpack_date(until);
+    r->exception_count = (int)exceptions;
+    if (exceptions) {
+        *keys = malloc(exceptions * sizeof(int));
+        if (!*keys) return 0;
+        for (unsigned long i = 0; i < exceptions; i++) {
+            (*keys)[i] = date_to_days(unpack_date(get_u32(p + RULE_HEADER_SIZE + i * 4)));
+        }
+    }
+    r->exceptions = *keys;
+    return RULE_HEADER_SIZE + exceptions * 4;
+}
+
+// String heap writer: text is interned, so identical strings share a
+// pointer and the pointer alone is enough to deduplicate.
+typedef struct {
+    ByteBuf heap;
+    const char **keys;
+    unsigned long *offsets;
+    size_t capacity, count;
+} HeapWriter;
+
+static int heap_init(HeapWriter *hw, size_t expected) {
+    memset(hw, 0, sizeof(*hw));
+    hw->capacity = 1024;
+    while (hw->capacity < expected * 2) hw->capacity *= 2;
+    hw->keys = (const char**)calloc(hw->capacity, sizeof(const char*));
+    hw->offsets = (unsigned long*)malloc(hw->capacity * sizeof(unsigned long));
+    if (!hw->keys || !hw->offsets || !buf_reserve(&hw->heap, 1)) return 0;
+    hw->heap.data[hw->heap.size++] = '\0';
+    return 1;
+}
+
+static void heap_free(HeapWriter *hw) {
+    free(hw->heap.data);
+    free(hw->keys);
+    free(hw->offsets);
+}
+
+static long heap_add(HeapWriter *hw, const char *str) {
+    if (!*str) return 0;
+    size_t h = ((size_t)str >> 3) * 2654435761u & (hw->capacity - 1);
+    while (hw->keys[h]) {
+        if (hw->keys[h] == str) return (long)hw->offsets[h];
+        h = (h + 1) & (hw->capacity - 1);
+    }
+    size_t len = strlen(str) + 1;
+    if (hw->heap.size + len > 0xFFFFFFFFu || !buf_reserve(&hw->heap, len)) return -1;
+    long offset = (long)hw->heap.size;
+    memcpy(hw->heap.data + hw->heap.size, str, len);
+    hw->keys[h] = str;
+    hw->offsets[h] = (unsigned long)offset;
+    hw->heap.size += len;
+    if (++hw->count * 2 > hw->capacity) {
+        // Grow by rebuilding; rare since heap_init sizes for the expected count
+        HeapWriter bigger = *hw;
+        bigger.capacity = hw->capacity * 2;
+        bigger.keys = (const char**)calloc(bigger.capacity, sizeof(const char*));
+        bigger.offsets = (unsigned long*)malloc(bigger.capacity * sizeof(unsigned long));
+        if (!bigger.keys || !bigger.offsets) {
+            free(bigger.keys);
+            free(bigger.offsets);
+            return -1;
+        }
+        for (size_t i = 0; i < hw->capacity; i++) {
+            if (!hw->keys[i]) continue;
+            size_t j = ((size_t)hw->keys[i] >> 3) * 2654435761u & (bigger.capacity - 1);
+            while (bigger.keys[j]) j = (j + 1) & (bigger.capacity - 1);
+            bigger.keys[j] = hw->keys[i];
+            bigger.offsets[j] = hw->offsets[i];
+        }
+        free(hw->keys);
+        free(hw->offsets);
+        *hw = bigger;
+    }
+    return offset;
+}
+
+static void encode_record(unsigned char *r, const Event *e, unsigned long desc, unsigned long loc) {
+    memset(r, 0, V4_RECORD_SIZE);
+    put_u32(r, (unsigned long)e->id);
+    put_u16(r + 4, (unsigned)e->date.year);
+    r[6] = (unsigned char)e->date.month;
+    r[7] = (unsigned char)e->date.day;
+    put_u16(r + 8, (unsigned)(e->start_time.hour * 60 + e->start_time.minute));
+    put_u16(r + 10, (unsigned)(e->end_time.hour * 60 + e->end_time.minute));
+    r[12] = (unsigned char)e->priority;
+    r[13] = (unsigned char)e->category;
+    r[14] = e->is_all_day ? V4_FLAG_ALL_DAY : 0;
+    put_u32(r + 16, (unsigned long)e->reminder_minutes);
+    put_u32(r + 20, desc);
+    put_u32(r + 24, loc);
+}
+
+// A real calendar date whose year fits the 16 bits v4 stores, so its date
+// key names the same day
+static int valid_stored_date(Date d) {
+    return d.year >= 1 && d.year <= 0xFFFF && d.month >= 1 && d.month <= 12 &&
+           d.day >= 1 && d.day <= days_in_month(d.month, d.year);
+}
+
+// Fills everything but the text from a record, rejecting bad values
+static int decode_record(const unsigned char *r, Event *e) {
+    int id = (int)get_u32(r);
+    unsigned start = get_u16(r + 8), end = get_u16(r + 10);
+    if (id <= 0 || start >= 1440 || end >= 1440 || r[12] > PRIORITY_CRITICAL || r[13] > CAT_OTHER) return 0;
+    e->id = id;
+    e->date.year = (int)get_u16(r + 4);
+    e->date.month = r[6];
+    e->date.day = r[7];
+    if (!valid_stored_date(e->date)) return 0;
+    e->date_key = date_to_days(e->date);
+    e->start_time.hour = (int)start / 60;
+    e->start_time.minute = (int)start % 60;
+    e->end_time.hour = (int)end / 60;
+    e->end_time.minute = (int)end % 60;
+    e->priority = (Priority)r[12];
+    e->category = (Category)r[13];
+    e->is_all_day = (r[14] & V4_FLAG_ALL_DAY) != 0;
+    e->reminder_minutes = (int)get_u32(r + 16);
+    e->deleted = 0;
+    e->repeat = NULL;
+    return 1;
+}
+
+// Serialises every live event into a complete v4 image
+static int encode_v4(ByteBuf *out) {
+    int count = table.live_count;
+    HeapWriter hw;
+    memset(out, 0, sizeof(*out));
+
+    size_t records_offset = V4_HEADER_SIZE + V4_SECTIONS * V4_SECTION_SIZE;
+    size_t records_size = (size_t)count * V4_RECORD_SIZE;
+    if (!heap_init(&hw, (size_t)count) || !buf_reserve(out, records_offset + records_size)) {
+        heap_free(&hw);
+        free(out->data);
+        return 0;
+    }
+    memset(out->data, 0, records_offset);
+    out->size = records_offset;
+
+    for (int i = 0; i < table.order_count; i++) {
+        Event *e = slot_event(table.order[i]);
+        if (e->deleted) continue;
+
+        long desc = heap_add(&hw, e->description);
+        long loc = heap_add(&hw, e->location);
+        if (desc < 0 || loc < 0) goto fail;
+
+        encode_record(out->data + out->size, e, (unsigned long)desc, (unsigned long)loc);
+        out->size += V4_RECORD_SIZE;
+    }
+
+    size_t strings_offset = out->size;
+    if (!buf_reserve(out, hw.heap.size)) goto fail;
+    memcpy(out->data + strings_offset, hw.heap.data, hw.heap.size);
+    out->size += hw.heap.size;
+
+    size_t series_offset = out->size;
+    for (int i = 0; i < table.series_count; i++) {
+        const Event *e = slot_event(table.series[i]);
+        if (!buf_reserve(out, 4 + rule_size(e->repeat))) goto fail;
+        put_u32(out->data + out->size, (unsigned long)e->id);
+        encode_rule(out->data + out->size + 4, e->repeat);
+        out->size += 4 + rule_size(e->repeat);
+    }
+
+    unsigned char *h = out->data;
+    put_u32(h, V4_MAGIC);
+    put_u16(h + 4, V4_VERSION);
+    put_u16(h + 6, V4_SECTIONS);
+    put_u32(h + 8, (unsigned long)count);
+    put_u32(h + 12, (unsigned long)next_id);
+    put_u32(h + 16, V4_RECORD_SIZE);
+
+    unsigned char *sec = h + V4_HEADER_SIZE;
+    put_u32(sec, SECTION_RECORDS);
+    put_u32(sec + 4, (unsigned long)count);
+    put_u64(sec + 8, records_offset);
+    put_u64(sec + 16, records_size);
+    sec += V4_SECTION_SIZE;
+    put_u32(sec, SECTION_STRINGS);
+    put_u32(sec + 4, (unsigned long)hw.count);
+    put_u64(sec + 8, strings_offset);
+    put_u64(sec + 16, hw.heap.size);
+    sec += V4_SECTION_SIZE;
+    put_u32(sec, SECTION_SERIES);
+    put_u32(sec + 4, (unsigned long)table.series_count);
+    put_u64(sec + 8, series_offset);
+    put_u64(sec + 16, out->size - series_offset);
+
+    heap_free(&hw);
+    return 1;
+
+fail:
+    heap_free(&hw);
+    free(out->data);
+    memset(out, 0, sizeof(*out));
+    return 0;
+}
+
+// Drops references into the mapped file by copying its text into the pool
+static void detach_mapped_file(void) {
+    if (!mapped_file.data) return;
+    rebuild_string_pool();
+    unmap_file(&mapped_file);
+}
+
+static int write_file_atomic(const char *filename, const void *data, size_t size) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return 0;
+    int ok = fwrite(data, 1, size, fp) == size && sync_file(fp);
+    ok = fclose(fp) == 0 && ok;
+    if (!ok) {
+        remove(tmp);
+        return 0;
+    }
+    if (!replace_file(tmp, filename)) {
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+int save_events_to(const char *filename) {
+    ByteBuf image;
+    if (!encode_v4(&image)) return 0;
+    if (PLATFORM_LOCKS_MAPPED_FILES) detach_mapped_file();
+    int ok = write_file_atomic(filename, image.data, image.size);
+    free(image.data);
+    return ok;
+}
+
+// Decodes a v4 image. Text is not copied: events point straight into
+// the string heap of the mapping, which stays mapped until free_events.
+// The fixed fields are decoded straight into arena slots, since the API
+// hands out Event pointers with native fields and edits write to them.
+// Records arrive in `order`, so appending them needs no sort.
+static int load_v4(const unsigned char *data, size_t size) {
+    if (size < V4_HEADER_SIZE || get_u32(data) != V4_MAGIC || get_u16(data + 4) != V4_VERSION) return 0;
+
+    unsigned sections = get_u16(data + 6);
+    unsigned long file_next_id = get_u32(data + 12);
+    size_t record_size = get_u32(data + 16);
+    if (record_size < V4_RECORD_SIZE || size < V4_HEADER_SIZE + (size_t)sections * V4_SECTION_SIZE) return 0;
+
+    const unsigned char *records = NULL, *heap = NULL, *series = NULL;
+    size_t record_count = 0, heap_size = 0, series_size = 0;
+    for (unsigned i = 0; i < sections; i++) {
+        const unsigned char *sec = data + V4_HEADER_SIZE + (size_t)i * V4_SECTION_SIZE;
+        unsigned long long offset = get_u64(sec + 8), len = get_u64(sec + 16);
+        if (offset > size || len > size - offset) return 0;
+        switch (get_u32(sec)) {
+            case SECTION_RECORDS:
+                records = data + offset;
+                record_count = (size_t)(len / record_size);
+                break;
+            case SECTION_STRINGS:
+                heap = data + offset;
+                heap_size = (size_t)len;
+                break;
+            case SECTION_SERIES:
+                series = data + offset;
+                series_size = (size_t)len;
+                break;
+        }
+    }
+    // Every string must end inside the heap
+    if (!records || !heap || heap_size == 0 || heap[heap_size - 1] != '\0') return 0;
+    if (record_count > MAX_EVENT_ID || file_next_id > MAX_EVENT_ID) return 0;
+
+    if ((int)file_next_id > next_id) next_id = (int)file_next_id;
+    if (!grow_array((void**)&table.order, &table.order_capacity,
+                    table.order_count + (int)record_count, sizeof(int)) ||
+        !ensure_id_capacity(next_id)) return 0;
+
+    begin_bulk_insert();
+    for (size_t i = 0; i < record_count; i++) {
+        const unsigned char *r = records + i * record_size;
+        unsigned long desc = get_u32(r + 20), loc = get_u32(r + 24);
+        int slot = alloc_slot();
+        if (slot < 0) break;
+        Event *e = slot_event(slot);
+        if (!decode_record(r, e) || desc >= heap_size || loc >= heap_size ||
+            !ensure_id_capacity(e->id) || table.id_slot[e->id] >= 0) {
+            release_slot(slot);
+            continue;
+        }
+        int id = e->id;
+        if (id >= next_id) next_id = id + 1;
+        e->description = (const char*)heap + desc;
+        e->location = (const char*)heap + loc;
+
+        order_insert(slot);
+        table.id_slot[id] = slot;
+        table.live_count++;
+        table.strings.live_bytes += event_text_bytes(e);
+    }
+
+    // Rules for unknown ids or with bad values are dropped, leaving the
+    // first occurrence as a one-off event
+    size_t pos = 0;
+    while (series && series_size - pos >= 4 + RULE_HEADER_SIZE) {
+        Recurrence rule;
+        int *keys;
+        size_t used = decode_rule(series + pos + 4, series_size - pos - 4, &rule, &keys);
+        if (!used) break;
+        set_event_repeat((int)get_u32(series + pos), &rule);
+        free(keys);
+        pos += 4 + used;
+    }
+    end_bulk_insert();
+    return 1;
+}
+
+// Reads the original 0xCAFEBABE layout written by v3.x
+static int load_legacy(const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return 0;
+
+    int magic, count;
+    if (fread(&magic, sizeof(int), 1, fp) != 1 || magic != (int)0xCAFEBABE) {
+        fclose(fp);
+        return 0;
+    }
+
+    int file_next_id;
+    if (fread(&file_next_id, sizeof(int), 1, fp) != 1 || fread(&count, sizeof(int), 1, fp) != 1 ||
+        count < 0 || count > MAX_EVENT_ID || !ensure_id_capacity(file_next_id)) {
+        fclose(fp);
+        return 0;
+    }
+    if (file_next_id > next_id) next_id = file_next_id;
+
+    begin_bulk_insert();
+    DiskEvent d;
+    for (int i = 0; i < count; i++) {
+        if (fread(&d, DISK_EVENT_SIZE, 1, fp) != 1) break;
+        if ((unsigned)d.priority > PRIORITY_CRITICAL || (unsigned)d.category > CAT_OTHER) continue;
+        // v4 stores the year in 16 bits; this also keeps date keys in range
+        if (!valid_stored_date(d.date)) continue;
+        if (d.id <= 0 || !ensure_id_capacity(d.id) || table.id_slot[d.id] >= 0) continue;
+        if (d.id >= next_id) next_id = d.id + 1;
+
+        d.description[LEGACY_DESC-1] = '\0';
+        d.location[LEGACY_LOC-1] = '\0';
+
+        int slot = alloc_slot();
+        if (slot < 0) break;
+        Event *e = slot_event(slot);
+        e->id = d.id;
+        if (!set_event_fields(e, d.date, d.start_time, d.end_time, d.description,
+                              d.location, d.priority, d.category,
+                              d.is_all_day, d.reminder_minutes)) {
+            release_slot(slot);
+            break;
+        }
+
+        order_insert(slot);
+        table.id_slot[e->id] = slot;
+        table.live_count++;
+        table.strings.live_bytes += event_text_bytes(e);
+    }
+    fclose(fp);
+
+    end_bulk_insert();
+    return 1;
+}
+
+int load_events_from(const char *filename) {
+    MappedFile mf;
+    if (!map_file(filename, &mf)) return LOAD_FAILED;
+
+    if (mf.size >= 4 && get_u32(mf.data) == V4_MAGIC) {
+        // Only one mapping is kept alive at a time
+        detach_mapped_file();
+        if (!load_v4(mf.data, mf.size)) {
+            unmap_file(&mf);
+            return LOAD_FAILED;
+        }
+        mapped_file = mf;
+        return LOAD_OK;
+    }
+
+    unmap_file(&mf);
+    return load_legacy(filename) ? LOAD_LEGACY : LOAD_FAILED;
+}
+
+void save_events(void) {
+    if (journal.base[0]) checkpoint_journal();
+    else save_events_to(DATA_FILE);
+}
+
+void load_events(void) {
+    // Old files are upgraded on first open; the original is kept as a backup
+    if (load_events_from(DATA_FILE) == LOAD_LEGACY) {
+        if (replace_file(DATA_FILE, DATA_FILE ".v3.bak")) {
+            save_events_to(DATA_FILE);
+        }
+    }
+    open_journal(DATA_FILE);
+}
+
+// Journal
+// <file>.jnl sits next to the base file and records every edit since the
+// last checkpoint, so an edit costs one small append instead of a rewrite:
+//   header   u32 magic "CALJ", u32 version
+//   entries  {u32 payload size, u32 FNV-1a of payload, payload}
+//   payload  u8 JOURNAL_PUT, v4 record with text lengths in place of
+//            offsets, description, location (both NUL-terminated), then
+//            the recurrence rule of a series (see encode_rule)
+//            u8 JOURNAL_DELETE, u32 id
+// Entries carry full event state, so replaying one twice is harmless and a
+// crash between writing the base file and truncating the journal is safe.
+// Replay stops at the first torn or corrupt entry.
+#define JOURNAL_MAGIC 0x4A4C4143u
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 8
+#define JOURNAL_ENTRY_HEADER 8
+#define JOURNAL_PUT 1
+#define JOURNAL_DELETE 2
+#define JOURNAL_CHECKPOINT_BYTES (1024 * 1024)
+
+static int persist_submit(int kind, unsigned char *data, size_t size, const char *path);
+
+static unsigned long checksum(const unsigned char *p, size_t len) {
+    unsigned long h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = ((h ^ p[i]) * 16777619u) & 0xFFFFFFFFu;
+    return h;
+}
+
+static void journal_name(char *buf, size_t size, const char *filename) {
+    snprintf(buf, size, "%s.jnl", filename);
+}
+
+static int apply_journal_entry(const unsigned char *p, size_t len) {
+    if (p[0] == JOURNAL_DELETE && len == 5) {
+        delete_event((int)get_u32(p + 1));
+        return 1;
+    }
+    if (p[0] != JOURNAL_PUT || len < 1 + V4_RECORD_SIZE + 2) return 0;
+
+    const unsigned char *r = p + 1;
+    size_t desc_len = get_u32(r + 20), loc_len = get_u32(r + 24);
+    const char *desc = (const char*)r + V4_RECORD_SIZE;
+    const char *loc = desc + desc_len + 1;
+    size_t fixed = 1 + V4_RECORD_SIZE + 2;
+    Event rec;
+    if (!decode_record(r, &rec) || desc_len > len - fixed || loc_len > len - fixed - desc_len ||
+        desc[desc_len] != '\0' || loc[loc_len] != '\0') return 0;
+
+    // An optional recurrence rule follows the text
+    size_t tail = len - fixed - desc_len - loc_len;
+    Recurrence rule;
+    int *keys = NULL;
+    if (tail && decode_rule((const unsigned char*)loc + loc_len + 1, tail, &rule, &keys) != tail) {
+        free(keys);
+        return 0;
+    }
+
+    Event *e;
+    if (find_event_by_id(rec.id)) {
+        e = update_event(rec.id, rec.date, rec.start_time, rec.end_time, desc, loc,
+                         rec.priority, rec.category, rec.is_all_day, rec.reminder_minutes);
+    } else {
+        e = insert_event(rec.id, rec.date, rec.start_time, rec.end_time, desc, loc,
+                         rec.priority, rec.category, rec.is_all_day, rec.reminder_minutes);
+    }
+    int ok = e && set_event_repeat(rec.id, tail ? &rule : NULL);
+    free(keys);
+    return ok;
+}
+
+// Applies every intact entry; *good_bytes ends at the last one applied
+static int replay_file(const char *path, size_t *good_bytes, size_t *file_bytes) {
+    MappedFile mf;
+    *good_bytes = *file_bytes = 0;
+    if (!map_file(path, &mf)) return 0;
+    *file_bytes = mf.size;
+    if (mf.size < JOURNAL_HEADER_SIZE || get_u32(mf.data) != JOURNAL_MAGIC ||
+        get_u32(mf.data + 4) != JOURNAL_VERSION) {
+        unmap_file(&mf);
+        return 0;
+    }
+
+    int applied = 0;
+    size_t pos = JOURNAL_HEADER_SIZE;
+    while (mf.size - pos >= JOURNAL_ENTRY_HEADER) {
+        size_t len = get_u32(mf.data + pos);
+        const unsigned char *payload = mf.data + pos + JOURNAL_ENTRY_HEADER;
+        if (len == 0 || len > mf.size - pos - JOURNAL_ENTRY_HEADER ||
+            checksum(payload, len) != get_u32(mf.data + pos + 4) ||
+            !apply_journal_entry(payload, len)) break;
+        pos += JOURNAL_ENTRY_HEADER + len;
+        applied++;
+    }
+    *good_bytes = pos;
+    unmap_file(&mf);
+    return applied;
+}
+
+int replay_journal(const char *filename) {
+    char path[1024];
+    size_t good, total;
+    journal_name(path, sizeof(path), filename);
+    return replay_file(path, &good, &total);
+}
+
+// Starts an empty journal file, replacing whatever was there
+static int reset_journal(void) {
+    unsigned char header[JOURNAL_HEADER_SIZE];
+    if (journal.fp) fclose(journal.fp);
+    journal.fp = fopen(journal.path, "wb");
+    if (!journal.fp) return 0;
+    put_u32(header, JOURNAL_MAGIC);
+    put_u32(header + 4, JOURNAL_VERSION);
+    if (fwrite(header, 1, sizeof(header), journal.fp) != sizeof(header) || !sync_file(journal.fp)) {
+        fclose(journal.fp);
+        journal.fp = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+int open_journal(const char *filename) {
+    close_journal();
+    snprintf(journal.base, sizeof(journal.base), "%s", filename);
+    journal_name(journal.path, sizeof(journal.path), filename);
+
+    size_t good, total;
+    int applied = replay_file(journal.path, &good, &total);
+    if (good == total && total > 0) {
+        journal.fp = fopen(journal.path, "ab");
+        journal.bytes = total;
+        return journal.fp ? applied : -1;
+    }
+    // Missing, torn or foreign journal: fold what was replayed into the
+    // base file before starting a fresh one
+    if (applied > 0 && !save_events_to(journal.base)) return -1;
+    journal.bytes = JOURNAL_HEADER_SIZE;
+    return reset_journal() ? applied : -1;
+}
+
+void close_journal(void) {
+    flush_persist_worker();
+    if (journal.fp) fclose(journal.fp);
+    memset(&journal, 0, sizeof(journal));
+}
+
+static int write_journal_entry(const unsigned char *entry, size_t size) {
+    return journal.fp && fwrite(entry, 1, size, journal.fp) == size;
+}
+
+// Takes ownership of a complete entry and writes it now, or queues it
+// for the worker
+static int submit_journal_entry(unsigned char *entry, size_t size) {
+    if (!journal.base[0]) {
+        free(entry);
+        return 0;
+    }
+    journal.bytes += size;
+    if (persist.thread) return persist_submit(PERSIST_JOURNAL, entry, size, NULL);
+    int ok = write_journal_entry(entry, size) && sync_file(journal.fp);
+    free(entry);
+    return ok;
+}
+
+// Allocates an entry with room for a payload of len bytes after the header
+static unsigned char* new_journal_entry(size_t len) {
+    return malloc(JOURNAL_ENTRY_HEADER + len);
+}
+
+static int finish_journal_entry(unsigned char *entry, size_t len) {
+    put_u32(entry, (unsigned long)len);
+    put_u32(entry + 4, checksum(entry + JOURNAL_ENTRY_HEADER, len));
+    return submit_journal_entry(entry, JOURNAL_ENTRY_HEADER + len);
+}
+
+int journal_put(const Event *e) {
+    size_t desc_len = strlen(e->description), loc_len = strlen(e->location);
+    size_t text_len = 1 + V4_RECORD_SIZE + desc_len + loc_len + 2;
+    size_t len = text_len + (e->repeat ? rule_size(e->repeat) : 0);
+    unsigned char *entry = new_journal_entry(len);
+    if (!entry) return 0;
+    unsigned char *p = entry + JOURNAL_ENTRY_HEADER;
+    p[0] = JOURNAL_PUT;
+    encode_record(p + 1, e, (unsigned long)desc_len, (unsigned long)loc_len);
+    memcpy(p + 1 + V4_RECORD_SIZE, e->description, desc_len + 1);
+    memcpy(p + 1 + V4_RECORD_SIZE + desc_len + 1, e->location, loc_len + 1);
+    if (e->repeat) encode_rule(p + text_len, e->repeat);
+    return finish_journal_entry(entry, len);
+}
+
+int journal_delete(int id) {
+    unsigned char *entry = new_journal_entry(5);
+    if (!entry) return 0;
+    unsigned char *p = entry + JOURNAL_ENTRY_HEADER;
+    p[0] = JOURNAL_DELETE;
+    put_u32(p + 1, (unsigned long)id);
+    return finish_journal_entry(entry, 5);
+}
+
+int journal_needs_checkpoint(void) {
+    return journal.base[0] && journal.bytes >= JOURNAL_CHECKPOINT_BYTES;
+}
+
+// Encodes the store on the calling thread and hands the image to the worker
+static int queue_snapshot(int kind, const char *path) {
+    ByteBuf image;
+    if (!encode_v4(&image)) return 0;
+    return persist_submit(kind, image.data, image.size, path);
+}
+
+int checkpoint_journal(void) {
+    if (!journal.base[0]) return 0;
+    journal.bytes = JOURNAL_HEADER_SIZE;
+    if (persist.thread) {
+        if (PLATFORM_LOCKS_MAPPED_FILES) detach_mapped_file();
+        return queue_snapshot(PERSIST_CHECKPOINT, NULL);
+    }
+    return save_events_to(journal.base) && reset_journal();
+}
+
+int backup_events(const char *filename) {
+    if (persist.thread) return queue_snapshot(PERSIST_BACKUP, filename);
+    return save_events_to(filename);
+}
+
+// Persistence worker
+// Owns all journal and snapshot writes while it runs. Each wake-up takes
+// the whole queue as one batch: if the batch holds snapshots only the last
+// is written, journal entries it already covers are dropped, and the rest
+// go out with a single flush.
+static void persist_done(int kind, int ok) {
+    if (persist.done) persist.done(kind, ok, persist.user);
+}
+
+static void run_persist_batch(PersistJob *batch) {
+    PersistJob *last_checkpoint = NULL;
+    for (PersistJob *j = batch; j; j = j->next) {
+        if (j->kind == PERSIST_CHECKPOINT) last_checkpoint = j;
+    }
+
+    int checkpoint_ok = 0;
+    if (last_checkpoint) {
+        checkpoint_ok = write_file_atomic(journal.base, last_checkpoint->data, last_checkpoint->size) &&
+                        reset_journal();
+    }
+
+    // If the snapshot could not be written, every entry still goes to the
+    // old journal so nothing is lost
+    int skip = checkpoint_ok, wrote = 0, journal_ok = 1;
+    for (PersistJob *j = batch; j; j = j->next) {
+        if (j == last_checkpoint) {
+            skip = 0;
+        } else if (j->kind == PERSIST_JOURNAL && !skip) {
+            journal_ok = write_journal_entry(j->data, j->size) && journal_ok;
+            wrote = 1;
+        } else if (j->kind == PERSIST_BACKUP) {
+            persist_done(PERSIST_BACKUP, write_file_atomic(j->path, j->data, j->size));
+        }
+    }
+    if (wrote) journal_ok = journal.fp && sync_file(journal.fp) && journal_ok;
+
+    if (last_checkpoint) persist_done(PERSIST_CHECKPOINT, checkpoint_ok);
+    if (wrote) persist_done(PERSIST_JOURNAL, journal_ok);
+
+    while (batch) {
+        PersistJob *next = batch->next;
+        free(batch->data);
+        free(batch->path);
+        free(batch);
+        batch = next;
+    }
+}
+
+static void persist_main(void *arg) {
+    (void)arg;
+    monitor_enter(persist.monitor);
+    for (;;) {
+        while (!persist.head && !persist.stopping) monitor_wait(persist.monitor);
+        if (!persist.head) break;
+        PersistJob *batch = persist.head;
+        persist.head = persist.tail = NULL;
+        persist.busy = 1;
+        monitor_leave(persist.monitor);
+
+        run_persist_batch(batch);
+
+        monitor_enter(persist.monitor);
+        persist.busy = 0;
+        monitor_notify_all(persist.monitor);
+    }
+    monitor_leave(persist.monitor);
+}
+
+// Queues data (which the worker frees) for writing
+static int persist_submit(int kind, unsigned char *data, size_t size, const char *path) {
+    PersistJob *job = calloc(1, sizeof(PersistJob));
+    if (job && path && (job->path = malloc(strlen(path) + 1))) strcpy(job->path, path);
+    if (!job || (path && !job->path)) {
+        free(job);
+        free(data);
+        return 0;
+    }
+    job->kind = kind;
+    job->data = data;
+    job->size = size;
+
+    monitor_enter(persist.monitor);
+    if (persist.tail) persist.tail->next = job;
+    else persist.head = job;
+    persist.tail = job;
+    monitor_notify_all(persist.monitor);
+    monitor_leave(persist.monitor);
+    return 1;
+}
+
+int start_persist_worker(PersistCallback done, void *user) {
+    if (persist.thread) return 1;
+    persist.monitor = monitor_create();
+    if (!persist.monitor) return 0;
+    persist.done = done;
+    persist.user = user;
+    persist.stopping = 0;
+    persist.thread = thread_start(persist_main, NULL);
+    if (!persist.thread) {
+        monitor_destroy(persist.monitor);
+        persist.monitor = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void flush_persist_worker(void) {
+    if (!persist.thread) return;
+    monitor_enter(persist.monitor);
+    while (persist.head || persist.busy) monitor_wait(persist.monitor);
+    monitor_leave(persist.monitor);
+}
+
+void stop_persist_worker(void) {
+    if (!persist.thread) return;
+    monitor_enter(persist.monitor);
+    persist.stopping = 1;
+    monitor_notify_all(persist.monitor);
+    monitor_leave(persist.monitor);
+    thread_join(persist.thread);
+    monitor_destroy(persist.monitor);
+    memset(&persist, 0, sizeof(persist));
+}
+
+// CSV export
+// Rows are formatted by hand into large buffers that are written whole.
+// The events are cut into blocks; each round, a few blocks per thread are
+// formatted as a parallel scan and the blocks are written in order.
+// Several small blocks per thread rather than one large one let threads
+// that finish early take over the work of slow ones, and from
+// EXPORT_PARALLEL_MIN rows on even 16 threads get a block each. Buffers
+// are reused from round to round, so memory stays at about
+// EXPORT_ROUND_BLOCKS * EXPORT_BLOCK_EVENTS rows per thread.
+#define EXPORT_BLOCK_EVENTS 4096
+#define EXPORT_ROUND_BLOCKS 4
+#define EXPORT_PARALLEL_MIN 65536
+#define EXPORT_ROW_FIXED 128   // a row without its text never needs more
+#define CSV_HEADER "ID,Date,Time,Description,Location,Priority,Category,Reminder\r\n"
+
+typedef struct {
+    const int *ids;      // NULL: positions in table.order
+    int first, end;
+    ByteBuf out;
+    int ok;
+} ExportBlock;
+
+// One round of blocks, starting at event `base`
+typedef struct {
+    const int *ids;
+    int base;
+    ExportBlock *blocks;
+} ExportRound;
+
+static char* csv_uint(char *p, unsigned v) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = digits[--n];
+    return p;
+}
+
+static char* csv_2digits(char *p, int v) {
+    p[0] = (char)('0' + v / 10 % 10);
+    p[1] = (char)('0' + v % 10);
+    return p + 2;
+}
+
+// Always quoted, with embedded quotes doubled (RFC 4180)
+static char* csv_text(char *p, const char *s) {
+    *p++ = '"';
+    for (;;) {
+        size_t run = strcspn(s, "\"");
+        memcpy(p, s, run);
+        p += run;
+        s += run;
+        if (!*s) break;
+        *p++ = '"';
+        *p++ = '"';
+        s++;
+    }
+    *p++ = '"';
+    return p;
+}
+
+static char* csv_word(char *p, const char *s) {
+    size_t len = strlen(s);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+static int format_csv_row(ByteBuf *b, const Event *e) {
+    size_t text = strlen(e->description) + strlen(e->location);
+    if (!buf_reserve(b, EXPORT_ROW_FIXED + 2 * text)) return 0;
+    char *start = (char*)b->data + b->size, *p = start;
+
+    p = csv_uint(p, (unsigned)e->id);
+    *p++ = ',';
+    p = csv_2digits(p, e->date.day);
+    *p++ = '/';
+    p = csv_2digits(p, e->date.month);
+    *p++ = '/';
+    p = csv_uint(p, (unsigned)e->date.year);
+    *p++ = ',';
+    if (e->is_all_day) {
+        p = csv_word(p, "All Day");
+    } else {
+        p = csv_2digits(p, e->start_time.hour);
+        *p++ = ':';
+        p = csv_2digits(p, e->start_time.minute);
+        *p++ = '-';
+        p = csv_2digits(p, e->end_time.hour);
+        *p++ = ':';
+        p = csv_2digits(p, e->end_time.minute);
+    }
+    *p++ = ',';
+    p = csv_text(p, e->description);
+    *p++ = ',';
+    p = csv_text(p, e->location);
+    *p++ = ',';
+    p = csv_word(p, priority_to_string(e->priority));
+    *p++ = ',';
+    p = csv_word(p, category_to_string(e->category));
+    *p++ = ',';
+    if (e->reminder_minutes < 0) *p++ = '-';
+    p = csv_uint(p, e->reminder_minutes < 0 ? 0u - (unsigned)e->reminder_minutes
+                                            : (unsigned)e->reminder_minutes);
+    p = csv_word(p, " min\r\n");
+    b->size += (size_t)(p - start);
+    return 1;
+}
+
+// Scan task; only reads the store
+static void format_export_block(int chunk, int first, int end, void *arg) {
+    ExportRound *round = (ExportRound*)arg;
+    ExportBlock *blk = &round->blocks[chunk];
+    blk->ids = round->ids;
+    blk->first = round->base + first;
+    blk->end = round->base + end;
+    blk->out.size = 0;
+    blk->ok = 1;
+    for (int i = blk->first; i < blk->end; i++) {
+        const Event *e = blk->ids ? find_event_by_id(blk->ids[i]) : slot_event(table.order[i]);
+        if (!e || e->deleted) continue;
+        if (!format_csv_row(&blk->out, e)) {
+            blk->ok = 0;
+            return;
+        }
+    }
+}
+
+int export_events_to_csv(const char *filename, const int *ids, int count, int threads) {
+    int total = ids ? count : table.order_count;
+    threads = total < EXPORT_PARALLEL_MIN ? 1 : scan_thread_count(threads);
+
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) return 0;
+
+    ExportBlock blocks[SCAN_MAX_THREADS * EXPORT_ROUND_BLOCKS];
+    ExportRound round = { ids, 0, blocks };
+    int round_events = threads * EXPORT_ROUND_BLOCKS * EXPORT_BLOCK_EVENTS;
+    memset(blocks, 0, sizeof(blocks));
+    int ok = fwrite(CSV_HEADER, 1, sizeof(CSV_HEADER) - 1, fp) == sizeof(CSV_HEADER) - 1;
+    for (int pos = 0; ok && pos < total; ) {
+        int n = total - pos < round_events ? total - pos : round_events;
+        round.base = pos;
+        run_scan(n, EXPORT_BLOCK_EVENTS, threads, format_export_block, &round);
+        for (int i = 0; i * EXPORT_BLOCK_EVENTS < n && ok; i++) {
+            ok = blocks[i].ok && (blocks[i].out.size == 0 ||
+                 fwrite(blocks[i].out.data, 1, blocks[i].out.size, fp) == blocks[i].out.size);
+        }
+        pos += n;
+    }
+    for (int i = 0; i < SCAN_MAX_THREADS * EXPORT_ROUND_BLOCKS; i++) free(blocks[i].out.data);
+    if (fclose(fp) != 0) ok = 0;
+    return ok;
+}
+
+int export_to_csv(const char *filename) {
+    return export_events_to_csv(filename, NULL, 0, 0);
+}
+
+// CSV import
+// The file is read in chunks; only complete records are parsed and the
+// incomplete tail moves to the front of the buffer for the next read.
+// Fields are split in place, so no text is copied before add_event
+// interns it.
+#define IMPORT_CHUNK (256 * 1024)
+#define IMPORT_MAX_RECORD (16 * 1024 * 1024)
+#define CSV_COLUMNS 8
+
+// A quote opens a field only as its first byte, "" inside it is an escaped
+// quote, and a quote closes it only before a comma, a line break or the end.
+// Any other quote is kept as text, as older exports did not escape them.
+// Record boundaries and field splitting both follow this rule.
+static int csv_quote_closes(const char *p, const char *end) {
+    return p + 1 == end || p[1] == ',' || p[1] == '\r' || p[1] == '\n';
+}
+
+// Splits one record into NUL-terminated fields: quotes are stripped and ""
+// unescaped by moving bytes down over the record itself. *end must be
+// writable. Returns the field count or -1 if there are more than max.
+static int split_csv_record(char *p, char *end, char **fields, int max) {
+    int n = 0;
+    for (;;) {
+        if (n == max) return -1;
+        char *out = p;
+        fields[n++] = out;
+        if (p < end && *p == '"') {
+            for (p++; p < end; ) {
+                if (*p == '"' && p + 1 < end && p[1] == '"') {
+                    *out++ = '"';
+                    p += 2;
+                } else if (*p == '"' && csv_quote_closes(p, end)) {
+                    p++;
+                    break;
+                } else {
+                    *out++ = *p++;
+                }
+            }
+        }
+        while (p < end && *p != ',') *out++ = *p++;
+        int more = p < end;
+        *out = '\0';
+        if (!more) return n;
+        p++;
+    }
+}
+
+// Reads 1 to max_digits decimal digits at *s; -1 if there are none
+static int parse_digits(const char **s, int max_digits) {
+    int v = 0, n = 0;
+    while (n < max_digits && **s >= '0' && **s <= '9') {
+        v = v * 10 + (*(*s)++ - '0');
+        n++;
+    }
+    return n ? v : -1;
+}
+
+static int parse_csv_date(const char *s, Date *d) {
+    d->day = parse_digits(&s, 2);
+    if (*s++ != '/') return 0;
+    d->month = parse_digits(&s, 2);
+    if (*s++ != '/') return 0;
+    d->year = parse_digits(&s, 5);
+    return *s == '\0' && d->year >= 1 && d->year <= 65535 && d->month >= 1 && d->month <= 12 &&
+           d->day >= 1 && d->day <= days_in_month(d->month, d->year);
+}
+
+static int parse_csv_time(const char **s, Time *t) {
+    t->hour = parse_digits(s, 2);
+    if (*(*s)++ != ':') return 0;
+    t->minute = parse_digits(s, 2);
+    return t->hour >= 0 && t->hour <= 23 && t->minute >= 0 && t->minute <= 59;
+}
+
+// Turns one split record into an event; returns the reason it was rejected
+static const char* import_csv_record(char **f, int count) {
+    Date date;
+    Time start = { 0, 0 }, end = { 0, 0 };
+    int all_day, priority, category, reminder;
+    const char *s;
+
+    // Only the first count fields are set
+    if (count != CSV_COLUMNS) return "expected 8 fields";
+    all_day = strcmp(f[2], "All Day") == 0;
+    s = f[0];
+    s += strspn(s, "0123456789");
+    if (s == f[0] || *s) return "bad ID";
+    if (!parse_csv_date(f[1], &date)) return "bad date (dd/mm/yyyy)";
+    s = f[2];
+    if (!all_day && !(parse_csv_time(&s, &start) && *s++ == '-' &&
+                      parse_csv_time(&s, &end) && *s == '\0')) {
+        return "bad time (HH:MM-HH:MM or All Day)";
+    }
+    for (priority = PRIORITY_CRITICAL; priority >= 0; priority--) {
+        if (strcmp(f[5], priority_to_string((Priority)priority)) == 0) break;
+    }
+    if (priority < 0) return "unknown priority";
+    for (category = CAT_OTHER; category >= 0; category--) {
+        if (strcmp(f[6], category_to_string((Category)category)) == 0) break;
+    }
+    if (category < 0) return "unknown category";
+    s = f[7];
+    reminder = parse_digits(&s, 9);
+    if (reminder < 0 || (*s && strcmp(s, " min") != 0)) return "bad reminder (N min)";
+
+    if (!add_event(date, start, end, f[3], f[4], (Priority)priority, (Category)category,
+                   all_day, reminder)) {
+        return "out of memory";
+    }
+    return NULL;
+}
+
+int import_from_csv(const char *filename, ImportResult *res,
+                    ImportErrorCallback bad_line, void *user) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return 0;
+
+    // One spare byte past the data so the last record can be terminated
+    size_t capacity = IMPORT_CHUNK, have = 0;
+    char *buf = malloc(capacity + 1);
+    if (!buf) {
+        fclose(fp);
+        return 0;
+    }
+
+    long line = 1;
+    int ok = 1, eof = 0;
+    memset(res, 0, sizeof(*res));
+    begin_bulk_insert();
+    while (!eof) {
+        if (have == capacity) {
+            // A single record fills the buffer: grow it, within reason
+            char *bigger = capacity < IMPORT_MAX_RECORD ? realloc(buf, capacity * 2 + 1) : NULL;
+            if (!bigger) {
+                if (bad_line) bad_line(line, "record too long, import stopped", user);
+                ok = 0;
+                break;
+            }
+            buf = bigger;
+            capacity *= 2;
+        }
+        size_t got = fread(buf + have, 1, capacity - have, fp);
+        if (got < capacity - have) {
+            eof = 1;
+            if (ferror(fp)) ok = 0;
+        }
+        have += got;
+
+        // Records end at a newline outside quotes; at EOF the rest is one too
+        size_t start = 0;
+        int quoted = 0, field_start = 1;
+        for (size_t i = 0; i < have || (eof && start < have); i++) {
+            if (i < have && quoted) {
+                if (buf[i] != '"') continue;
+                if (i + 1 == have && !eof) break;   // the next byte decides
+                if (i + 1 < have && buf[i + 1] == '"') i++;
+                else if (csv_quote_closes(buf + i, buf + have)) quoted = 0;
+                continue;
+            }
+            if (i < have && buf[i] == '"' && field_start) {
+                quoted = 1;
+                field_start = 0;
+                continue;
+            }
+            field_start = i == have || buf[i] == ',' || buf[i] == '\n';
+            if (i < have && buf[i] != '\n') continue;
+
+            char *rec = buf + start, *end = buf + i;
+            long rec_line = line;
+            for (char *p = rec; p < end; p++) line += *p == '\n';
+            if (i < have) line++;
+            start = i + 1;
+            if (end > rec && end[-1] == '\r') end--;
+            if (end == rec) continue;
+
+            char *fields[CSV_COLUMNS];
+            int count = split_csv_record(rec, end, fields, CSV_COLUMNS);
+            res->lines++;
+            if (rec_line == 1 && count > 0 && strcmp(fields[0], "ID") == 0) continue;
+            const char *reason = count < 0 ? "too many fields" : import_csv_record(fields, count);
+            if (reason) {
+                res->rejected++;
+                if (bad_line) bad_line(rec_line, reason, user);
+            } else {
+                res->imported++;
+            }
+        }
+        if (start > have) start = have;
+        memmove(buf, buf + start, have - start);
+        have -= start;
+    }
+    end_bulk_insert();
+    free(buf);
+    fclose(fp);
+    return ok;
+}
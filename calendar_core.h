@@ -0,0 +1,381 @@
+// Portable event store shared by the Win32 UI and the headless CLI.
+// Nothing in here may include <windows.h>.
+#ifndef CALENDAR_CORE_H
+#define CALENDAR_CORE_H
+
+#include <stddef.h>
+
+#define DATA_FILE "calendar.dat"
+
+typedef enum {
+    PRIORITY_LOW = 0, PRIORITY_MEDIUM, PRIORITY_HIGH, PRIORITY_CRITICAL
+} Priority;
+
+typedef enum {
+    CAT_WORK, CAT_PERSONAL, CAT_BIRTHDAY, CAT_MEETING,
+    CAT_APPOINTMENT, CAT_REMINDER, CAT_HOLIDAY, CAT_OTHER
+} Category;
+
+
+typedef struct {
+    int day, month, year;
+} Date;
+
+typedef struct {
+    int hour, minute;
+} Time;
+
+typedef enum {
+    REPEAT_NONE, REPEAT_DAILY, REPEAT_WEEKLY, REPEAT_MONTHLY, REPEAT_YEARLY
+} RepeatFrequency;
+
+#define MAX_REPEAT_COUNT 100000
+#define MAX_REPEAT_EXCEPTIONS 1024
+
+// Recurrence rule of a series. The series is one event whose date is the
+// first occurrence; later ones are computed on demand. Monthly and yearly
+// series skip months that lack the start day (31st, 29 February).
+typedef struct {
+    RepeatFrequency frequency;
+    int interval;            // every interval days / weeks / months / years
+    int count;               // occurrences in total, 0 = no limit
+    Date until;              // no occurrences after this date; year 0 = no limit
+    int exception_count;
+    const int *exceptions;   // skipped occurrences as sorted date keys
+    int last_key;            // date key of the last occurrence, maintained by the store
+} Recurrence;
+
+// Hot fields are stored inline; description and location point at
+// interned strings owned by the store and are never NULL.
+typedef struct Event {
+    int id;
+    Date date;
+    int date_key;            // date_to_days(date), maintained by the store
+    Time start_time, end_time;
+    Priority priority;
+    Category category;
+    int is_all_day;
+    int reminder_minutes;
+    int deleted;
+    const char *description;
+    const char *location;
+    const Recurrence *repeat; // NULL for a one-off event, owned by the store
+} Event;
+
+// Columns the event list can be sorted by
+typedef enum {
+    SORT_ID, SORT_DATE, SORT_TIME, SORT_DESCRIPTION, SORT_LOCATION,
+    SORT_PRIORITY, SORT_CATEGORY, SORT_COLUMNS
+} SortColumn;
+
+// Filter applied by list views and the headless driver.
+// NULL / empty / -1 fields match everything. search matches description
+// or location, ignoring case. A series matches a date filter if any of
+// its occurrences falls in it.
+typedef struct {
+    const Date *date;
+    const char *search;
+    int category;
+    int priority;
+    const Date *date_to;     // with date, an inclusive range instead of one day
+} EventFilter;
+
+// Storage counters for monitoring
+typedef struct {
+    int live;         // events visible to the application
+    int dead;         // deleted events still waiting for compaction
+    int free_slots;   // reclaimed slots ready for reuse
+    int slots;        // slots ever handed out
+    int compactions;  // compaction passes run so far
+    int arena_chunks;           // chunks held by the event arena
+    size_t arena_bytes_used;    // bytes in slots holding live or dead events
+    size_t arena_bytes_wasted;  // bytes in free or never-used slots
+    int strings;                // distinct interned strings
+    size_t string_bytes;        // bytes held by the string pool
+} StoreStats;
+
+extern int next_id;
+
+// Utility functions
+int is_leap_year(int year);
+int days_in_month(int month, int year);
+int compare_dates(Date d1, Date d2);
+// Days since 1 January 1970 and back; consecutive dates differ by one
+int date_to_days(Date d);
+Date days_to_date(int days);
+int day_of_week(Date d);     // 0 = Monday ... 6 = Sunday
+void get_today(Date *d);
+const char* priority_to_string(Priority p);
+const char* category_to_string(Category c);
+char* str_to_lower(char *s);
+
+// Minutes since 1 January 1970 in local time. All-day events start at
+// midnight.
+long long local_minute_now(void);
+long long event_start_minute(const Event *e);
+
+// Event management
+// Events live in arena slots and a table kept ordered by (date, start time, id).
+// Returned pointers stay valid until the event is deleted and compacted, or
+// free_events releases the arena.
+Event* add_event(Date date, Time start, Time end, const char *desc,
+                 const char *loc, Priority pri, Category cat,
+                 int all_day, int reminder);
+Event* update_event(int id, Date date, Time start, Time end, const char *desc,
+                    const char *loc, Priority pri, Category cat,
+                    int all_day, int reminder);
+Event* find_event_by_id(int id);
+void delete_event(int id);
+int has_events_on_date(Date d);
+// Day occupancy, answered from a per-month index kept current by edits
+// plus the occurrences of each series in that month.
+// month_busy_days sets bit (day - 1) for every day with at least one
+// event; day_event_count also reports the highest priority (-1 if none).
+unsigned month_busy_days(int year, int month);
+int day_event_count(Date d, int *max_priority);
+int count_events(void);
+
+// Dashboard figures from counters that add, edit and delete keep current
+// (built on first use like the indexes), so reading them costs the same
+// whatever the number of events. A series counts once in the totals.
+// Busiest days and month histograms count every occurrence; busiest days
+// are ranked on the first read after a change and cover the months from
+// the first to the last holding an event or the start of a series.
+#define STATS_BUSIEST_DAYS 5
+
+typedef struct {
+    Date date;
+    int events;
+} DayCount;
+
+typedef struct {
+    int total, all_day, with_reminder, repeating;
+    int priorities[4];
+    int categories[8];
+    long long category_minutes[8];          // start to end of timed events
+    DayCount busiest[STATS_BUSIEST_DAYS];   // most events first, then earliest
+    int busiest_count;
+} EventStats;
+
+void get_event_stats(EventStats *st);
+// Events and series occurrences in each of `months` consecutive months
+// starting at year/month
+void month_histogram(int year, int month, int months, int *counts);
+
+// Time conflicts. An event covers start to end on its day (end excluded),
+// an all-day event the whole day, and one whose end is not after its
+// start just its first minute. One-off events are kept in an interval
+// tree built on first use and kept current by edits, so a query costs
+// O(log n) plus the overlaps found; series occurrences are checked per
+// query.
+// find_overlaps reports the events overlapping the given time on day d,
+// other than exclude_id (0 for none): up to max ids go to ids, one-off
+// events in date order and then series. Returns the number found, or -1
+// if out of memory.
+int find_overlaps(Date d, Time start, Time end, int all_day, int exclude_id, int *ids, int max);
+// find_series_overlaps does the same for an event not yet saved with
+// the given repeat rule (NULL for none) and first date d, checking each
+// occurrence in the days from d on. Each event is reported once, in the
+// order first met. Returns the number of events found, or -1 if out of
+// memory or the rule is invalid.
+int find_series_overlaps(Date d, Time start, Time end, int all_day, const Recurrence *rule,
+                         int days, int exclude_id, int *ids, int max);
+
+typedef struct {
+    Date date;
+    int first, second;       // ids; first starts earlier (or has the lower id)
+    Time start;              // when the overlap begins
+    int minutes;             // how long it lasts
+} EventConflict;
+
+// Every pair of overlapping events or occurrences dated from..to, ordered
+// by date, then overlap start and ids. Writes up to max conflicts and
+// returns how many were written (max means there may be more), or -1 if
+// out of memory.
+int find_conflicts(Date from, Date to, EventConflict *out, int max);
+
+// Free time. find_free_slots walks the days from..to and reports, earliest
+// first, the gaps of at least q->minutes inside the working hours that no
+// event or occurrence overlaps (same coverage rules as above). Each gap is
+// reported whole, so callers can book any part of it.
+typedef struct {
+    Date from, to;               // days searched, inclusive
+    Time day_start, day_end;     // working hours; day_end may be 24:00
+    int minutes;                 // shortest useful gap
+    unsigned weekdays;           // bit 0 = Monday ... bit 6 = Sunday; 0 = every day
+    unsigned ignore_categories;  // bit c set: events of category c never block
+    long long not_before;        // local minute the search starts at, 0 for none
+} SlotQuery;
+
+typedef struct {
+    Date date;
+    Time start, end;             // end excluded; 24:00 is midnight
+} FreeSlot;
+
+// Writes up to max slots and returns how many were written, or -1 for an
+// invalid query or if out of memory.
+int find_free_slots(const SlotQuery *q, FreeSlot *out, int max);
+
+// Recurrence. set_event_repeat copies the rule (exceptions included) or
+// turns the series back into a one-off event when rule is NULL or
+// REPEAT_NONE; it returns 0 for an invalid rule. Date filters, day
+// occupancy and reminders all see every occurrence of a series.
+int set_event_repeat(int id, const Recurrence *rule);
+int skip_occurrence(int id, Date d);      // adds d to the exceptions
+int next_occurrence(const Event *e, Date on_or_after, Date *occurrence);
+int series_count(void);
+Event* series_at(int i);                  // live series, in no particular order
+void describe_repeat(const Recurrence *r, char *buf, size_t size);
+
+void compact_events(void);
+void get_store_stats(StoreStats *st);
+void free_events(void);
+int event_matches(const Event *e, const EventFilter *f);
+
+// Changes whenever an event is added, updated or deleted, so results
+// computed earlier can be checked for staleness
+unsigned long store_version(void);
+
+// 1 if every event matching narrow is certain to match wide as well:
+// same or tighter date/category/priority and a search that contains the
+// wider one. A refined result can then be filtered from the wider one.
+int filter_narrows(const EventFilter *narrow, const EventFilter *wide);
+
+// Between these calls add_event appends without keeping date order and
+// the table is sorted once at the end. Do not query the table meanwhile.
+void begin_bulk_insert(void);
+void end_bulk_insert(void);
+
+// Date-ordered traversal. Positions run from 0 to event_table_size() - 1 and
+// may include deleted entries, so callers must skip e->deleted. A delete can
+// trigger compaction, which shifts positions.
+int event_table_size(void);
+Event* event_at(int pos);
+int first_event_on_or_after(Date d);
+// Positions *first .. *first + count - 1 hold every event dated from..to
+// (inclusive), found by binary search; returns count. Series are placed by
+// their first occurrence, so those that began before from are not in the
+// slice (see series_at).
+int event_range(Date from, Date to, int *first);
+// Parallel scans. Column filters over large slices, the first build of
+// the statistics counters and CSV export split the table into chunks run
+// on the calling thread plus a pool of worker threads started on demand.
+// Results are merged in chunk order, so they are the same for any thread
+// count. Scans are meant for one thread at a time; one started while
+// another runs stays on its caller's thread.
+#define SCAN_MAX_THREADS 16
+
+void set_scan_threads(int threads);   // 0 = one per processor (the default)
+int scan_threads(void);               // threads a scan would use now
+void stop_scan_workers(void);         // ends the pool, e.g. before exit
+
+// Filter over positions first .. first + count - 1 into a selection
+// bitmap: bit i of bits (which holds (count + 31) / 32 words) is set when
+// event_at(first + i) matches f exactly as event_matches would. Returns
+// the number of bits set. Date, category and priority are tested with
+// AVX2 or SSE2 on narrow per-position columns (day keys, one byte per
+// priority, category and tombstone) that follow every edit, so events
+// are only read for series and the search text.
+int select_events(const EventFilter *f, int first, int count, unsigned *bits);
+
+// Column sorting. Each column has a permutation of the live events ordered
+// by that column, then by date order. It is built on first use and then
+// kept current by add, update and delete; bulk inserts drop it. Walk it
+// backwards for descending order.
+int compare_events_by(SortColumn col, const Event *a, const Event *b);
+int sorted_event_count(SortColumn col);
+Event* sorted_event_at(SortColumn col, int pos);
+
+// Full-text search over description and location, case-insensitive.
+// Uses a trigram index built on first use and kept current by edits.
+// Returns the number of matching events and points *ids at their ids in
+// date order (valid until the next call), or -1 if the query is shorter
+// than 3 characters and the caller has to scan with event_matches.
+int search_events(const char *query, const int **ids);
+
+// The substring test behind search and event_matches: ASCII
+// case-insensitive, on the text in place. Runs an AVX2 or SSE2 kernel
+// when the CPU has one; text_match_kernel names the one in use.
+int text_contains_nocase(const char *text, const char *query);
+const char* text_match_kernel(void);      // "avx2", "sse2" or "scalar"
+// Switches to the named kernel, or back to the widest one for NULL, for
+// tests and benchmarks (not while a scan runs). Returns 0, keeping the
+// widest, if the CPU cannot run it.
+int use_text_match_kernel(const char *name);
+
+// Reminders. Every live event with reminder_minutes > 0 is queued in a
+// min-heap by its due minute (start - reminder_minutes), built on first use
+// and kept current by edits. pop_due_reminders(now) dequeues reminders due
+// by now and returns up to max ids of events that have not started yet.
+// A series has one entry, for its next occurrence, which is requeued for
+// the following occurrence once popped. A reminder is handed out once, even across bulk inserts, until
+// free_events clears the store.
+int pending_reminders(void);
+int next_reminder_due(long long *due);    // 0 if nothing is queued
+int pop_due_reminders(long long now, int *ids, int max);
+
+// File I/O
+// load_events_from result
+#define LOAD_FAILED 0
+#define LOAD_OK 1
+#define LOAD_LEGACY 2   // pre-v4 0xCAFEBABE file, rewritten as v4 by load_events
+
+int save_events_to(const char *filename);
+int load_events_from(const char *filename);
+void save_events(void);
+void load_events(void);
+// CSV export (RFC 4180: text always quoted with quotes doubled, CRLF line
+// ends). export_to_csv writes every live event in date order.
+// export_events_to_csv writes the events with the given ids in that order,
+// e.g. a filtered list view, or every event when ids is NULL. Large exports
+// are formatted on up to `threads` threads (0 = the set_scan_threads
+// default) and still written in order.
+int export_to_csv(const char *filename);
+int export_events_to_csv(const char *filename, const int *ids, int count, int threads);
+
+// CSV import of the layout export_to_csv writes, read in chunks so the file
+// is never held in memory whole. Rows become new events (the ID column is
+// checked but not kept, so they never clash with existing ids), added as
+// one bulk insert; nothing is saved. bad_line, if set, gets the line number
+// and reason of every rejected row. Returns 0 if the file could not be
+// read to the end; events imported until then stay.
+typedef struct {
+    long lines;       // non-blank records, header included
+    int imported;
+    int rejected;
+} ImportResult;
+
+typedef void (*ImportErrorCallback)(long line, const char *reason, void *user);
+
+int import_from_csv(const char *filename, ImportResult *res,
+                    ImportErrorCallback bad_line, void *user);
+
+// Write-ahead journal (<file>.jnl). After an edit, journal_put or
+// journal_delete appends and flushes one small entry instead of rewriting
+// the whole file; checkpoint_journal folds the journal into the base file.
+// load_events and save_events do this for DATA_FILE automatically.
+int open_journal(const char *filename);   // replays, then appends; entries applied or -1
+void close_journal(void);
+int replay_journal(const char *filename); // read-only replay, returns entries applied
+int journal_put(const Event *e);
+int journal_delete(int id);
+int journal_needs_checkpoint(void);
+int checkpoint_journal(void);
+int backup_events(const char *filename);  // writes a snapshot of the store
+
+// Background persistence. While the worker runs, journal_put,
+// journal_delete, checkpoint_journal and backup_events only encode their
+// data on the calling thread and queue it; the worker batches queued
+// entries into one flush and writes only the newest pending snapshot.
+// done(kind, ok, user) is called on the worker thread after each write.
+#define PERSIST_JOURNAL 1
+#define PERSIST_CHECKPOINT 2
+#define PERSIST_BACKUP 3
+
+typedef void (*PersistCallback)(int kind, int ok, void *user);
+
+int start_persist_worker(PersistCallback done, void *user);
+void flush_persist_worker(void);   // waits until everything queued is written
+void stop_persist_worker(void);    // flushes, then ends the worker
+
+#endif
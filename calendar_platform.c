@@ -0,0 +1,240 @@
+// OS-specific pieces of the core, see calendar_platform.h
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calendar_platform.h"
+
+#ifdef _WIN32
+
+int map_file(const char *path, MappedFile *mf) {
+    memset(mf, 0, sizeof(*mf));
+    HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                             NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return 0;
+    }
+
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return 0;
+
+    // The view keeps the section alive after the handle is closed
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return 0;
+
+    mf->data = (const unsigned char*)view;
+    mf->size = (size_t)size.QuadPart;
+    return 1;
+}
+
+void unmap_file(MappedFile *mf) {
+    if (mf->data) UnmapViewOfFile(mf->data);
+    memset(mf, 0, sizeof(*mf));
+}
+
+int sync_file(FILE *fp) {
+    if (fflush(fp) != 0) return 0;
+    return _commit(_fileno(fp)) == 0;
+}
+
+int replace_file(const char *src, const char *dst) {
+    return MoveFileEx(src, dst, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+struct PlatformThread {
+    HANDLE handle;
+    void (*fn)(void *arg);
+    void *arg;
+};
+
+struct PlatformMonitor {
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+};
+
+int cpu_count(void) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+}
+
+static DWORD WINAPI thread_entry(LPVOID param) {
+    PlatformThread *t = (PlatformThread*)param;
+    t->fn(t->arg);
+    return 0;
+}
+
+PlatformThread* thread_start(void (*fn)(void *arg), void *arg) {
+    PlatformThread *t = (PlatformThread*)malloc(sizeof(PlatformThread));
+    if (!t) return NULL;
+    t->fn = fn;
+    t->arg = arg;
+    t->handle = CreateThread(NULL, 0, thread_entry, t, 0, NULL);
+    if (!t->handle) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void thread_join(PlatformThread *t) {
+    if (!t) return;
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+    free(t);
+}
+
+PlatformMonitor* monitor_create(void) {
+    PlatformMonitor *m = (PlatformMonitor*)malloc(sizeof(PlatformMonitor));
+    if (!m) return NULL;
+    InitializeCriticalSection(&m->lock);
+    InitializeConditionVariable(&m->cond);
+    return m;
+}
+
+void monitor_destroy(PlatformMonitor *m) {
+    if (!m) return;
+    DeleteCriticalSection(&m->lock);
+    free(m);
+}
+
+void monitor_enter(PlatformMonitor *m) {
+    EnterCriticalSection(&m->lock);
+}
+
+void monitor_leave(PlatformMonitor *m) {
+    LeaveCriticalSection(&m->lock);
+}
+
+void monitor_wait(PlatformMonitor *m) {
+    SleepConditionVariableCS(&m->cond, &m->lock, INFINITE);
+}
+
+void monitor_notify_all(PlatformMonitor *m) {
+    WakeAllConditionVariable(&m->cond);
+}
+
+#else
+
+int map_file(const char *path, MappedFile *mf) {
+    memset(mf, 0, sizeof(*mf));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return 0;
+
+    mf->data = (const unsigned char*)view;
+    mf->size = (size_t)st.st_size;
+    return 1;
+}
+
+void unmap_file(MappedFile *mf) {
+    if (mf->data) munmap((void*)mf->data, mf->size);
+    memset(mf, 0, sizeof(*mf));
+}
+
+int sync_file(FILE *fp) {
+    if (fflush(fp) != 0) return 0;
+    return fsync(fileno(fp)) == 0;
+}
+
+int replace_file(const char *src, const char *dst) {
+    return rename(src, dst) == 0;
+}
+
+struct PlatformThread {
+    pthread_t handle;
+    void (*fn)(void *arg);
+    void *arg;
+};
+
+struct PlatformMonitor {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+int cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static void* thread_entry(void *param) {
+    PlatformThread *t = (PlatformThread*)param;
+    t->fn(t->arg);
+    return NULL;
+}
+
+PlatformThread* thread_start(void (*fn)(void *arg), void *arg) {
+    PlatformThread *t = (PlatformThread*)malloc(sizeof(PlatformThread));
+    if (!t) return NULL;
+    t->fn = fn;
+    t->arg = arg;
+    if (pthread_create(&t->handle, NULL, thread_entry, t) != 0) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void thread_join(PlatformThread *t) {
+    if (!t) return;
+    pthread_join(t->handle, NULL);
+    free(t);
+}
+
+PlatformMonitor* monitor_create(void) {
+    PlatformMonitor *m = (PlatformMonitor*)malloc(sizeof(PlatformMonitor));
+    if (!m) return NULL;
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->cond, NULL);
+    return m;
+}
+
+void monitor_destroy(PlatformMonitor *m) {
+    if (!m) return;
+    pthread_mutex_destroy(&m->lock);
+    pthread_cond_destroy(&m->cond);
+    free(m);
+}
+
+void monitor_enter(PlatformMonitor *m) {
+    pthread_mutex_lock(&m->lock);
+}
+
+void monitor_leave(PlatformMonitor *m) {
+    pthread_mutex_unlock(&m->lock);
+}
+
+void monitor_wait(PlatformMonitor *m) {
+    pthread_cond_wait(&m->cond, &m->lock);
+}
+
+void monitor_notify_all(PlatformMonitor *m) {
+    pthread_cond_broadcast(&m->cond);
+}
+
+#endif
@@ -0,0 +1,49 @@
+// Thin OS layer for the core: file mapping, durable file replacement and
+// the few threading primitives the background workers need.
+// The Win32 branch lives in calendar_platform.c so that calendar_core.c
+// itself never includes <windows.h>.
+#ifndef CALENDAR_PLATFORM_H
+#define CALENDAR_PLATFORM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Windows refuses to replace a file while a view of it is mapped
+#ifdef _WIN32
+#define PLATFORM_LOCKS_MAPPED_FILES 1
+#else
+#define PLATFORM_LOCKS_MAPPED_FILES 0
+#endif
+
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+} MappedFile;
+
+// Read-only view of a whole file. Returns 0 if the file is missing or empty.
+int map_file(const char *path, MappedFile *mf);
+void unmap_file(MappedFile *mf);
+
+// Flushes stdio buffers and asks the OS to push the file to disk
+int sync_file(FILE *fp);
+
+// Atomically replaces dst with src
+int replace_file(const char *src, const char *dst);
+
+// Threads and monitors are opaque so callers never see OS headers.
+// A monitor is a mutex paired with one condition variable.
+typedef struct PlatformThread PlatformThread;
+typedef struct PlatformMonitor PlatformMonitor;
+
+int cpu_count(void);                   // logical processors, at least 1
+PlatformThread* thread_start(void (*fn)(void *arg), void *arg);
+void thread_join(PlatformThread *t);   // waits for the thread and frees it
+
+PlatformMonitor* monitor_create(void);
+void monitor_destroy(PlatformMonitor *m);
+void monitor_enter(PlatformMonitor *m);
+void monitor_leave(PlatformMonitor *m);
+void monitor_wait(PlatformMonitor *m);     // must hold m; may wake spuriously
+void monitor_notify_all(PlatformMonitor *m);
+
+#endif
@@ -1,4 +1,4 @@
-// gcc -o calendar_win32.exe calendar_win32.c -mwindows -lcomctl32 -lgdi32
+// gcc -o calendar_win32.exe calendar_win32.c calendar_core.c calendar_platform.c -mwindows -lcomctl32 -lgdi32
 #include <windows.h>
 #include <commctrl.h>
 #include <stdio.h>
@@ -6,11 +6,9 @@
 #include <string.h>
 #include <time.h>
 
-#pragma comment(lib, "comctl32.lib")
+#include "calendar_core.h"
 
-#define MAX_DESC 200
-#define MAX_LOC 100
-#define DATA_FILE "calendar.dat"
+#pragma comment(lib, "comctl32.lib")
 
 // Control IDs
 #define ID_CALENDAR 1001
@@ -29,6 +27,11 @@
 #define ID_VIEW_DETAILS 1014
 #define ID_IMPORT 1015
 #define ID_BACKUP 1016
+#define ID_VIEW_WEEK 1017
+#define ID_VIEW_MONTH 1018
+#define ID_VIEW_AGENDA 1019
+#define ID_BLEND_CATEGORY 1020
+#define ID_FIND_SLOT 1021
 
 // Dialog controls
 #define IDC_DESC 2001
@@ -44,6 +47,18 @@
 #define IDC_REMINDER_MIN 2012
 #define IDC_SAVE 2013
 #define IDC_CANCEL 2014
+#define IDC_REPEAT 2015
+#define IDC_REPEAT_EVERY 2016
+#define IDC_REPEAT_COUNT 2017
+#define IDC_SLOT_MINUTES 2018
+#define IDC_SLOT_FROM 2019
+#define IDC_SLOT_TO 2020
+#define IDC_SLOT_DAYS 2021
+#define IDC_SLOT_WEEKDAYS 2022
+#define IDC_SLOT_REMINDERS 2023
+#define IDC_SLOT_FIND 2024
+#define IDC_SLOT_LIST 2025
+#define IDC_SLOT_BOOK 2026
 
 // Keyboard shortcuts
 #define IDM_NEW 3001
@@ -52,93 +67,97 @@
 #define IDM_SEARCH 3004
 #define IDM_REFRESH 3005
 
-typedef enum {
-    PRIORITY_LOW = 0, PRIORITY_MEDIUM, PRIORITY_HIGH, PRIORITY_CRITICAL
-} Priority;
+#define MAX_SEARCH 256
 
-typedef enum {
-    CAT_WORK, CAT_PERSONAL, CAT_BIRTHDAY, CAT_MEETING,
-    CAT_APPOINTMENT, CAT_REMINDER, CAT_HOLIDAY, CAT_OTHER
-} Category;
+// Typing in the search box refreshes the list once it pauses this long
+#define ID_SEARCH_TIMER 1
+#define SEARCH_DEBOUNCE_MS 150
 
+// Days covered by the agenda view, today included
+#define AGENDA_DAYS 30
 
-typedef struct {
-    int day, month, year;
-} Date;
+// Free slots listed by Find Slot
+#define SLOTS_SHOWN 20
 
-typedef struct {
-    int hour, minute;
-} Time;
-
-typedef struct Event {
-    int id;
-    Date date;
-    Time start_time, end_time;
-    char description[MAX_DESC];
-    char location[MAX_LOC];
-    Priority priority;
-    Category category;
-    int is_all_day;
-    int reminder_minutes;
-    int deleted;
-    struct Event *next;
-} Event;
+// Reminders shown per alert, and the longest the reminder timer is armed
+// for before the next deadline is looked up again (clock changes)
+#define REMINDER_BATCH 16
+#define REMINDER_MAX_WAIT_MS (60 * 60 * 1000)
+
+// Posted by the persistence worker: wParam = PERSIST_* kind, lParam = ok
+#define WM_APP_PERSIST (WM_APP + 1)
 
 // Global variables
-Event *event_list = NULL;
-int next_id = 1;
 HWND hwndMain, hwndCalendar, hwndListView, hwndStatus, hwndSearchBox;
 HWND hwndAddDialog = NULL;
+HWND hwndSlotDialog = NULL;
 HINSTANCE hInst;
 Date g_selected_date;
 int g_edit_mode = 0;
 int g_edit_event_id = 0;
+char g_backup_file[MAX_PATH] = "";
 
-// Filter state
-char g_search_filter[MAX_DESC] = "";
-int g_category_filter = -1; // -1 = all
-int g_priority_filter = -1; // -1 = all
+// Waitable timer armed for the earliest queued reminder; the message loop
+// waits on it together with the message queue
+HANDLE g_reminder_timer = NULL;
 
-// Utility functions
-int is_leap_year(int year) {
-    return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
-}
+// Rows of the owner-data list: ids of the events that passed the filter
+int *g_view_ids = NULL;
+int g_view_count = 0;
+int g_view_capacity = 0;
 
-int days_in_month(int month, int year) {
-    int days[] = {31,28,31,30,31,30,31,31,30,31,30,31};
-    if (month == 2 && is_leap_year(year)) return 29;
-    return days[month-1];
-}
+// Per row, the event and its background, resolved once when the rows are
+// built so painting never looks anything up. Only trusted while the store
+// is at g_view_rows_version.
+typedef struct {
+    Event *event;
+    COLORREF color;
+} ViewRow;
 
-int compare_dates(Date d1, Date d2) {
-    if (d1.year != d2.year) return d1.year - d2.year;
-    if (d1.month != d2.month) return d1.month - d2.month;
-    return d1.day - d2.day;
-}
+ViewRow *g_view_rows = NULL;
+unsigned long g_view_rows_version = 0;
 
-void get_today(Date *d) {
-    SYSTEMTIME st;
-    GetLocalTime(&st);
-    d->day = st.wDay;
-    d->month = st.wMonth;
-    d->year = st.wYear;
-}
+// Mix the category color into each row's priority color
+int g_blend_category = 0;
 
-const char* priority_to_string(Priority p) {
-    switch(p) {
-        case PRIORITY_LOW: return "Low";
-        case PRIORITY_MEDIUM: return "Medium";
-        case PRIORITY_HIGH: return "High";
-        case PRIORITY_CRITICAL: return "Critical";
-        default: return "Unknown";
-    }
-}
+// Date range the rows were picked for; a series row stands for its first
+// occurrence in it
+int g_view_ranged = 0;
+Date g_view_from;
 
-const char* category_to_string(Category c) {
-    const char *cats[] = {"Work", "Personal", "Birthday", "Meeting",
-                          "Appointment", "Reminder", "Holiday", "Other"};
-    return cats[c];
-}
+// List sort order; list columns are numbered like SortColumn
+SortColumn g_sort_column = SORT_DATE;
+int g_sort_descending = 0;
+
+// Query that produced the current rows. A narrower query with the same
+// sort over an unchanged store filters these rows instead of rescanning.
+typedef struct {
+    int valid;
+    int has_date;
+    Date date, date_to;
+    char search[MAX_SEARCH];
+    int category, priority;
+    SortColumn sort_column;
+    int sort_descending;
+    unsigned long version;
+} ViewQuery;
+
+ViewQuery g_view_query;
+
+// Bold-day masks handed to the month calendar, one per month shown
+MONTHDAYSTATE *g_day_states = NULL;
+int g_day_state_capacity = 0;
+
+// Filter state
+char g_search_filter[MAX_SEARCH] = "";
+
+// Last Find Slot results and the duration they were searched for
+FreeSlot g_slots[SLOTS_SHOWN];
+int g_slot_count = 0;
+int g_slot_minutes = 0;
+
+int g_category_filter = -1; // -1 = all
+int g_priority_filter = -1; // -1 = all
 
 
 COLORREF get_priority_color(Priority p) {
@@ -165,289 +184,304 @@ COLORREF get_category_color(Category c) {
     }
 }
 
-// Event management
-Event* create_event(Date date, Time start, Time end, const char *desc,
-                   const char *loc, Priority pri, Category cat,
-                   int all_day, int reminder) {
-    Event *e = (Event*)malloc(sizeof(Event));
-    if (!e) return NULL;
-    
-    e->id = next_id++;
-    e->date = date;
-    e->start_time = start;
-    e->end_time = end;
-    strncpy(e->description, desc, MAX_DESC-1);
-    e->description[MAX_DESC-1] = '\0';
-    strncpy(e->location, loc, MAX_LOC-1);
-    e->location[MAX_LOC-1] = '\0';
-    e->priority = pri;
-    e->category = cat;
-    e->is_all_day = all_day;
-    e->reminder_minutes = reminder;
-    e->deleted = 0;
-    e->next = NULL;
-    
-    return e;
+// Runs on the persistence worker; the window handles the result
+void on_persist_done(int kind, int ok, void *user) {
+    PostMessage((HWND)user, WM_APP_PERSIST, (WPARAM)kind, (LPARAM)ok);
 }
 
-void add_event_to_list(Event *e) {
-    if (!event_list) {
-        event_list = e;
-        return;
+// Queues a snapshot of the current events; WM_APP_PERSIST reports back
+void backup_data() {
+    time_t now = time(NULL);
+    struct tm *t = localtime(&now);
+    sprintf(g_backup_file, "calendar_backup_%04d%02d%02d_%02d%02d%02d.dat",
+            t->tm_year + 1900, t->tm_mon + 1, t->tm_mday,
+            t->tm_hour, t->tm_min, t->tm_sec);
+    
+    if (backup_events(g_backup_file)) {
+        SetWindowText(hwndStatus, "Creating backup...");
+    } else {
+        MessageBox(hwndMain, "Could not start the backup.", "Backup Failed", MB_OK | MB_ICONERROR);
     }
-    Event *curr = event_list;
-    while (curr->next) curr = curr->next;
-    curr->next = e;
 }
 
-Event* find_event_by_id(int id) {
-    Event *e = event_list;
-    while (e) {
-        if (e->id == id && !e->deleted) return e;
-        e = e->next;
-    }
-    return NULL;
+// UI Functions
+// Grows the row array; returns 0 when out of memory
+int reserve_view_rows(int needed) {
+    if (needed <= g_view_capacity) return 1;
+    int capacity = g_view_capacity ? g_view_capacity : 256;
+    while (capacity < needed) capacity *= 2;
+    int *rows = (int*)realloc(g_view_ids, capacity * sizeof(int));
+    if (!rows) return 0;
+    g_view_ids = rows;
+    ViewRow *resolved = (ViewRow*)realloc(g_view_rows, capacity * sizeof(ViewRow));
+    if (!resolved) return 0;
+    g_view_rows = resolved;
+    g_view_capacity = capacity;
+    return 1;
 }
 
-void delete_event(int id) {
-    Event *e = find_event_by_id(id);
-    if (e) e->deleted = 1;
+COLORREF get_row_color(const Event *e) {
+    COLORREF pri = get_priority_color(e->priority);
+    if (!g_blend_category) return pri;
+    COLORREF cat = get_category_color(e->category);
+    return RGB((GetRValue(pri) + GetRValue(cat)) / 2,
+               (GetGValue(pri) + GetGValue(cat)) / 2,
+               (GetBValue(pri) + GetBValue(cat)) / 2);
 }
 
-int has_events_on_date(Date d) {
-    Event *e = event_list;
-    while (e) {
-        if (!e->deleted && compare_dates(e->date, d) == 0) {
-            return 1;
-        }
-        e = e->next;
+// Resolves the event and color of every row
+void resolve_view_rows(void) {
+    for (int i = 0; i < g_view_count; i++) {
+        Event *e = find_event_by_id(g_view_ids[i]);
+        g_view_rows[i].event = e;
+        g_view_rows[i].color = e ? get_row_color(e) : RGB(255, 255, 255);
     }
-    return 0;
+    g_view_rows_version = store_version();
 }
 
-// File I/O
-void save_events() {
-    FILE *fp = fopen(DATA_FILE, "wb");
-    if (!fp) return;
-    
-    int magic = 0xCAFEBABE;
-    fwrite(&magic, sizeof(int), 1, fp);
-    fwrite(&next_id, sizeof(int), 1, fp);
-    
-    int count = 0;
-    Event *e = event_list;
-    while (e) {
-        if (!e->deleted) count++;
-        e = e->next;
+// Date shown for a row: the occurrence of a series in the current range
+Date row_date(const Event *e) {
+    Date d = e->date;
+    if (e->repeat && g_view_ranged) next_occurrence(e, g_view_from, &d);
+    return d;
+}
+
+// qsort callback ordering row ids by the current sort column
+int compare_view_rows(const void *a, const void *b) {
+    const Event *x = find_event_by_id(*(const int*)a), *y = find_event_by_id(*(const int*)b);
+    int c = 0;
+    if (g_sort_column == SORT_DATE) {
+        int kx = date_to_days(row_date(x)), ky = date_to_days(row_date(y));
+        c = (kx > ky) - (kx < ky);
     }
-    fwrite(&count, sizeof(int), 1, fp);
-    
-    e = event_list;
-    while (e) {
-        if (!e->deleted) {
-            fwrite(e, sizeof(Event) - sizeof(Event*), 1, fp);
+    if (c == 0) c = compare_events_by(g_sort_column, x, y);
+    return g_sort_descending ? -c : c;
+}
+
+// Shows the sort arrow on the active column header only
+void update_sort_arrows(void) {
+    HWND header = ListView_GetHeader(hwndListView);
+    for (int col = 0; col < SORT_COLUMNS; col++) {
+        HDITEM hdi = {0};
+        hdi.mask = HDI_FORMAT;
+        Header_GetItem(header, col, &hdi);
+        hdi.fmt &= ~(HDF_SORTUP | HDF_SORTDOWN);
+        if (col == (int)g_sort_column) {
+            hdi.fmt |= g_sort_descending ? HDF_SORTDOWN : HDF_SORTUP;
         }
-        e = e->next;
+        Header_SetItem(header, col, &hdi);
     }
-    fclose(fp);
 }
 
-void load_events() {
-    FILE *fp = fopen(DATA_FILE, "rb");
-    if (!fp) return;
-    
-    int magic, count;
-    fread(&magic, sizeof(int), 1, fp);
-    if (magic != 0xCAFEBABE) {
-        fclose(fp);
-        return;
-    }
-    
-    fread(&next_id, sizeof(int), 1, fp);
-    fread(&count, sizeof(int), 1, fp);
-    
-    for (int i = 0; i < count; i++) {
-        Event *e = (Event*)malloc(sizeof(Event));
-        if (!e) break;
-        fread(e, sizeof(Event) - sizeof(Event*), 1, fp);
-        e->next = NULL;
-        add_event_to_list(e);
+// True if the current rows were built for a wider query over the same
+// store and sort order, so the new rows are a subset of them
+int can_refine_view(const EventFilter *filter) {
+    if (!g_view_query.valid || g_view_query.version != store_version() ||
+        g_view_query.sort_column != g_sort_column ||
+        g_view_query.sort_descending != g_sort_descending) {
+        return 0;
     }
-    fclose(fp);
+    EventFilter last = { g_view_query.has_date ? &g_view_query.date : NULL, g_view_query.search,
+                         g_view_query.category, g_view_query.priority,
+                         g_view_query.has_date ? &g_view_query.date_to : NULL };
+    return filter_narrows(filter, &last);
 }
 
-void backup_data() {
-    char filename[MAX_PATH];
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    sprintf(filename, "calendar_backup_%04d%02d%02d_%02d%02d%02d.dat",
-            t->tm_year + 1900, t->tm_mon + 1, t->tm_mday,
-            t->tm_hour, t->tm_min, t->tm_sec);
-    
-    FILE *src = fopen(DATA_FILE, "rb");
-    if (!src) return;
-    
-    FILE *dst = fopen(filename, "wb");
-    if (!dst) {
-        fclose(src);
-        return;
-    }
-    
-    char buffer[4096];
-    size_t bytes;
-    while ((bytes = fread(buffer, 1, sizeof(buffer), src)) > 0) {
-        fwrite(buffer, 1, bytes, dst);
+void remember_view_query(const Date *from, const Date *to) {
+    g_view_query.valid = 1;
+    g_view_query.has_date = from != NULL;
+    if (from) {
+        g_view_query.date = *from;
+        g_view_query.date_to = to ? *to : *from;
     }
-    
-    fclose(src);
-    fclose(dst);
-    
-    char msg[500];
-    sprintf(msg, "Backup created successfully:\n%s", filename);
-    MessageBox(hwndMain, msg, "Backup Complete", MB_OK | MB_ICONINFORMATION);
+    strcpy(g_view_query.search, g_search_filter);
+    g_view_query.category = g_category_filter;
+    g_view_query.priority = g_priority_filter;
+    g_view_query.sort_column = g_sort_column;
+    g_view_query.sort_descending = g_sort_descending;
+    g_view_query.version = store_version();
 }
 
-void export_to_csv(const char *filename) {
-    FILE *fp = fopen(filename, "w");
-    if (!fp) return;
+// Rebuilds the filtered row array for the events dated from..to, or all
+// events when from is NULL. The list is LVS_OWNERDATA, so it only learns
+// the row count here and asks for text via LVN_GETDISPINFO.
+void update_list_range(const Date *from, const Date *to) {
+    int total = count_events();
+    if (from && !to) to = from;
     
-    fprintf(fp, "ID,Date,Time,Description,Location,Priority,Category,Reminder\n");
+    EventFilter filter = { from, g_search_filter, g_category_filter, g_priority_filter, to };
     
-    Event *e = event_list;
-    while (e) {
-        if (!e->deleted) {
-            fprintf(fp, "%d,%02d/%02d/%d,", e->id, e->date.day, e->date.month, e->date.year);
-            if (e->is_all_day) {
-                fprintf(fp, "All Day,");
-            } else {
-                fprintf(fp, "%02d:%02d-%02d:%02d,", 
-                       e->start_time.hour, e->start_time.minute,
-                       e->end_time.hour, e->end_time.minute);
-            }
-            fprintf(fp, "\"%s\",\"%s\",%s,%s,%d min\n",
-                   e->description, e->location,
-                   priority_to_string(e->priority),
-                   category_to_string(e->category),
-                   e->reminder_minutes);
-        }
-        e = e->next;
+    int date_order = g_sort_column == SORT_DATE && !g_sort_descending;
+    // Series rows are dated by their occurrence in the range, not by the
+    // table's order, so they always need a sort
+    int series_rows = from && series_count() > 0;
+    const int *hits;
+    int hit_count = -1;
+    int refine = can_refine_view(&filter) && !series_rows;
+    g_view_ranged = from != NULL;
+    if (from) g_view_from = *from;
+    if (!refine) {
+        g_view_count = 0;
+        if (g_search_filter[0]) hit_count = search_events(g_search_filter, &hits);
     }
-    fclose(fp);
-}
-
-// UI Functions
-void update_list_view(Date *filter_date) {
-    ListView_DeleteAllItems(hwndListView);
     
-    Event *e = event_list;
-    int idx = 0;
-    int total = 0;
-    
-    while (e) {
-        if (!e->deleted) {
-            int show = 1;
-            
-            // Apply date filter
-            if (filter_date && compare_dates(e->date, *filter_date) != 0) {
-                show = 0;
+    if (refine) {
+        // Results can only shrink: keep the current rows that still match
+        int kept = 0;
+        for (int i = 0; i < g_view_count; i++) {
+            Event *e = find_event_by_id(g_view_ids[i]);
+            if (e && event_matches(e, &filter)) g_view_ids[kept++] = g_view_ids[i];
+        }
+        g_view_count = kept;
+    } else if (hit_count >= 0) {
+        // The search index already matched the text, in date order
+        filter.search = NULL;
+        for (int i = 0; i < hit_count; i++) {
+            Event *e = find_event_by_id(hits[i]);
+            if (event_matches(e, &filter)) {
+                if (!reserve_view_rows(g_view_count + 1)) break;
+                g_view_ids[g_view_count++] = e->id;
             }
-            
-            // Apply search filter
-            if (show && strlen(g_search_filter) > 0) {
-                char desc_lower[MAX_DESC], search_lower[MAX_DESC];
-                strcpy(desc_lower, e->description);
-                strcpy(search_lower, g_search_filter);
-                _strlwr(desc_lower);
-                _strlwr(search_lower);
-                if (strstr(desc_lower, search_lower) == NULL) {
-                    show = 0;
+        }
+        if (!date_order || series_rows) {
+            qsort(g_view_ids, g_view_count, sizeof(int), compare_view_rows);
+        }
+    } else if (from || date_order) {
+        // The table is date-ordered, so a date range is one contiguous slice
+        int pos = 0, end = event_table_size();
+        if (from) {
+            end = event_range(*from, *to, &pos);
+            end += pos;
+        }
+        // selected from the filter columns into a bitmap
+        int words = (end - pos + 31) / 32;
+        unsigned *bits = (unsigned*)malloc((words + 1) * sizeof(unsigned));
+        int matches = bits ? select_events(&filter, pos, end - pos, bits) : 0;
+        if (matches > 0 && reserve_view_rows(matches)) {
+            for (int w = 0; w < words; w++) {
+                for (int b = 0; bits[w] && b < 32; b++) {
+                    if (bits[w] >> b & 1) g_view_ids[g_view_count++] = event_at(pos + w * 32 + b)->id;
                 }
             }
-            
-            // Apply category filter
-            if (show && g_category_filter != -1 && e->category != g_category_filter) {
-                show = 0;
-            }
-            
-            // Apply priority filter
-            if (show && g_priority_filter != -1 && e->priority != g_priority_filter) {
-                show = 0;
+        }
+        free(bits);
+        // plus the series that began before it
+        for (int i = 0; series_rows && i < series_count(); i++) {
+            Event *e = series_at(i);
+            if (e->date_key < date_to_days(*from) && event_matches(e, &filter)) {
+                if (!reserve_view_rows(g_view_count + 1)) break;
+                g_view_ids[g_view_count++] = e->id;
             }
-            
-            if (show) {
-                LVITEM lvi = {0};
-                char buffer[50];
-                
-                // Column 0: ID
-                lvi.mask = LVIF_TEXT | LVIF_PARAM;
-                lvi.iItem = idx;
-                lvi.iSubItem = 0;
-                lvi.lParam = (LPARAM)e->id;
-                sprintf(buffer, "%d", e->id);
-                lvi.pszText = buffer;
-                int item_idx = ListView_InsertItem(hwndListView, &lvi);
-                
-                if (item_idx == -1) {
-                    MessageBox(hwndMain, "Failed to insert item!", "Debug", MB_OK);
-                    continue;
-                }
-                
-                // Date
-                sprintf(buffer, "%02d/%02d/%d", e->date.day, e->date.month, e->date.year);
-                ListView_SetItemText(hwndListView, item_idx, 1, buffer);
-                
-                // Time
-                if (e->is_all_day) {
-                    strcpy(buffer, "All Day");
-                } else {
-                    sprintf(buffer, "%02d:%02d-%02d:%02d", 
-                           e->start_time.hour, e->start_time.minute,
-                           e->end_time.hour, e->end_time.minute);
-                }
-                ListView_SetItemText(hwndListView, item_idx, 2, buffer);
-                
-                // Description
-                ListView_SetItemText(hwndListView, item_idx, 3, e->description);
-                
-                // Location
-                ListView_SetItemText(hwndListView, item_idx, 4, e->location);
-                
-                // Priority
-                ListView_SetItemText(hwndListView, item_idx, 5, (char*)priority_to_string(e->priority));
-                
-                // Category
-                ListView_SetItemText(hwndListView, item_idx, 6, (char*)category_to_string(e->category));
-                
-                idx++;
+        }
+        // A range's worth of rows is small enough to sort directly
+        if (!date_order || series_rows) {
+            qsort(g_view_ids, g_view_count, sizeof(int), compare_view_rows);
+        }
+    } else {
+        // Walk the cached permutation for the column, backwards when descending
+        int n = sorted_event_count(g_sort_column);
+        for (int i = 0; i < n; i++) {
+            Event *e = sorted_event_at(g_sort_column, g_sort_descending ? n - 1 - i : i);
+            if (event_matches(e, &filter)) {
+                if (!reserve_view_rows(g_view_count + 1)) break;
+                g_view_ids[g_view_count++] = e->id;
             }
-            total++;
         }
-        e = e->next;
     }
     
+    remember_view_query(from, to);
+    resolve_view_rows();
+    ListView_SetItemCountEx(hwndListView, g_view_count, LVSICF_NOSCROLL);
+    
     char status[100];
-    sprintf(status, "Total Events: %d | Showing: %d", total, idx);
+    sprintf(status, "Total Events: %d | Showing: %d", total, g_view_count);
     SetWindowText(hwndStatus, status);
     
-    // Force redraw
     InvalidateRect(hwndListView, NULL, TRUE);
-    UpdateWindow(hwndListView);
+}
+
+void update_list_view(Date *filter_date) {
+    update_list_range(filter_date, filter_date);
+}
+
+// Day currently selected in the month calendar
+Date get_calendar_date(void) {
+    SYSTEMTIME st;
+    MonthCal_GetCurSel(hwndCalendar, &st);
+    Date d = { st.wDay, st.wMonth, st.wYear };
+    return d;
+}
+
+// Shows the days from..to, selecting from in the calendar
+void show_date_range(Date from, Date to, const char *label) {
+    SYSTEMTIME st = {0};
+    st.wYear = from.year;
+    st.wMonth = from.month;
+    st.wDay = from.day;
+    MonthCal_SetCurSel(hwndCalendar, &st);
+    
+    update_list_range(&from, &to);
+    
+    char status[160];
+    sprintf(status, "%s %02d/%02d/%d - %02d/%02d/%d | Showing: %d", label,
+            from.day, from.month, from.year, to.day, to.month, to.year, g_view_count);
+    SetWindowText(hwndStatus, status);
+}
+
+// Event behind a list row, or NULL if the row is gone
+Event* get_row_event(int row) {
+    if (row < 0 || row >= g_view_count) return NULL;
+    if (g_view_rows_version != store_version()) return find_event_by_id(g_view_ids[row]);
+    return g_view_rows[row].event;
+}
+
+// Id of the selected row, or 0 if nothing is selected
+int get_selected_event_id(void) {
+    int idx = ListView_GetNextItem(hwndListView, -1, LVNI_SELECTED);
+    if (idx < 0 || idx >= g_view_count) return 0;
+    return g_view_ids[idx];
+}
+
+// Writes one column of a row for LVN_GETDISPINFO
+void format_event_column(const Event *e, int column, char *buf, int size) {
+    switch (column) {
+        case 0: snprintf(buf, size, "%d", e->id); break;
+        case 1: {
+            Date d = row_date(e);
+            snprintf(buf, size, e->repeat ? "%02d/%02d/%d (repeats)" : "%02d/%02d/%d",
+                     d.day, d.month, d.year);
+            break;
+        }
+        case 2:
+            if (e->is_all_day) {
+                snprintf(buf, size, "All Day");
+            } else {
+                snprintf(buf, size, "%02d:%02d-%02d:%02d",
+                         e->start_time.hour, e->start_time.minute,
+                         e->end_time.hour, e->end_time.minute);
+            }
+            break;
+        case 3: snprintf(buf, size, "%s", e->description); break;
+        case 4: snprintf(buf, size, "%s", e->location); break;
+        case 5: snprintf(buf, size, "%s", priority_to_string(e->priority)); break;
+        case 6: snprintf(buf, size, "%s", category_to_string(e->category)); break;
+        default: if (size > 0) buf[0] = '\0'; break;
+    }
 }
 
 void debug_print_events() {
     int count = 0;
-    Event *e = event_list;
     char msg[1000] = "Events in memory:\n\n";
     
-    while (e && count < 5) {  // Show first 5 events
+    for (int pos = 0; pos < event_table_size() && count < 5; pos++) {  // Show first 5 events
+        Event *e = event_at(pos);
         if (!e->deleted) {
             char temp[200];
-            sprintf(temp, "ID:%d - %s (%02d/%02d/%d)\n", 
+            snprintf(temp, sizeof(temp), "ID:%d - %s (%02d/%02d/%d)\n", 
                    e->id, e->description, e->date.day, e->date.month, e->date.year);
             strcat(msg, temp);
             count++;
         }
-        e = e->next;
     }
     
     if (count == 0) {
@@ -463,6 +497,13 @@ void show_event_details(int event_id) {
     
     char details[2000];
     char time_str[100];
+    char repeat_str[200] = "";
+    
+    if (e->repeat) {
+        char rule[160];
+        describe_repeat(e->repeat, rule, sizeof(rule));
+        snprintf(repeat_str, sizeof(repeat_str), "Repeats: %s\n", rule);
+    }
     
     if (e->is_all_day) {
         strcpy(time_str, "All Day");
@@ -472,7 +513,7 @@ void show_event_details(int event_id) {
                e->end_time.hour, e->end_time.minute);
     }
     
-    sprintf(details,
+    snprintf(details, sizeof(details),
            "===================================\n"
            "           EVENT DETAILS\n"
            "===================================\n\n"
@@ -480,6 +521,7 @@ void show_event_details(int event_id) {
            "Description: %s\n"
            "Location: %s\n\n"
            "Date: %02d/%02d/%d\n"
+           "%s"
            "Time: %s\n\n"
            "Priority: %s\n"
            "Category: %s\n\n"
@@ -488,6 +530,7 @@ void show_event_details(int event_id) {
            e->id, e->description, 
            strlen(e->location) > 0 ? e->location : "(No location)",
            e->date.day, e->date.month, e->date.year,
+           repeat_str,
            time_str,
            priority_to_string(e->priority),
            category_to_string(e->category),
@@ -497,6 +540,204 @@ void show_event_details(int event_id) {
     MessageBox(hwndMain, details, "Event Details", MB_OK | MB_ICONINFORMATION);
 }
 
+// Reads a control's full text into a malloc'd buffer
+char* get_dlg_item_text_alloc(HWND hwnd, int id) {
+    HWND ctl = GetDlgItem(hwnd, id);
+    int len = GetWindowTextLength(ctl);
+    char *buf = (char*)malloc(len + 1);
+    if (!buf) return NULL;
+    GetWindowText(ctl, buf, len + 1);
+    return buf;
+}
+
+// Fills g_day_states for count months starting at first; NULL if out of memory
+MONTHDAYSTATE* get_day_states(SYSTEMTIME first, int count) {
+    if (count > g_day_state_capacity) {
+        MONTHDAYSTATE *states = (MONTHDAYSTATE*)realloc(g_day_states, count * sizeof(MONTHDAYSTATE));
+        if (!states) return NULL;
+        g_day_states = states;
+        g_day_state_capacity = count;
+    }
+    int year = first.wYear, month = first.wMonth;
+    for (int i = 0; i < count; i++) {
+        g_day_states[i] = month_busy_days(year, month);
+        if (++month > 12) {
+            month = 1;
+            year++;
+        }
+    }
+    return g_day_states;
+}
+
+// Re-bolds the months currently shown after events change
+void refresh_day_states(void) {
+    SYSTEMTIME range[2];
+    int count = (int)MonthCal_GetMonthRange(hwndCalendar, GMR_DAYSTATE, range);
+    MONTHDAYSTATE *states = get_day_states(range[0], count);
+    if (states) {
+        MonthCal_SetDayState(hwndCalendar, count, states);
+    }
+}
+
+// Arms the reminder timer for the next deadline in the reminder heap
+void arm_reminder_timer(void) {
+    long long due;
+    if (!g_reminder_timer) return;
+    if (!next_reminder_due(&due)) {
+        CancelWaitableTimer(g_reminder_timer);
+        return;
+    }
+    
+    long long wait_ms = (due - local_minute_now()) * 60000 - (long long)(time(NULL) % 60) * 1000;
+    if (wait_ms < 0) wait_ms = 0;
+    if (wait_ms > REMINDER_MAX_WAIT_MS) wait_ms = REMINDER_MAX_WAIT_MS;
+    
+    LARGE_INTEGER when;
+    when.QuadPart = -wait_ms * 10000;   // relative, in 100 ns units
+    SetWaitableTimer(g_reminder_timer, &when, 0, NULL, NULL, FALSE);
+}
+
+// Runs when the reminder timer fires: shows what came due and re-arms
+void fire_reminders(void) {
+    int ids[REMINDER_BATCH];
+    int n = pop_due_reminders(local_minute_now(), ids, REMINDER_BATCH);
+    arm_reminder_timer();
+    if (n == 0) return;
+    
+    char msg[2048];
+    int len = 0;
+    for (int i = 0; i < n && len < (int)sizeof(msg) - 1; i++) {
+        Event *e = find_event_by_id(ids[i]);
+        if (!e) continue;
+        if (e->is_all_day) {
+            len += snprintf(msg + len, sizeof(msg) - len, "All day  %s", e->description);
+        } else {
+            len += snprintf(msg + len, sizeof(msg) - len, "%02d:%02d  %s",
+                            e->start_time.hour, e->start_time.minute, e->description);
+        }
+        if (len < (int)sizeof(msg) - 1 && e->location[0]) {
+            len += snprintf(msg + len, sizeof(msg) - len, " (%s)", e->location);
+        }
+        if (len < (int)sizeof(msg) - 1) {
+            len += snprintf(msg + len, sizeof(msg) - len, "\n");
+        }
+    }
+    
+    FlashWindow(hwndMain, TRUE);
+    MessageBeep(MB_ICONINFORMATION);
+    MessageBox(hwndMain, msg, "Reminder", MB_OK | MB_ICONINFORMATION);
+}
+
+// Called after each edit was journaled. Falls back to a full save if the
+// journal could not be written, checkpoints once it grows large, and
+// updates the bold days on the calendar and the reminder timer.
+void persist_edit(int journaled) {
+    if (!journaled || journal_needs_checkpoint()) {
+        save_events();
+    }
+    refresh_day_states();
+    arm_reminder_timer();
+}
+
+// Collects the first few rejected lines of an import for the summary
+typedef struct {
+    char text[600];
+    int shown;
+} ImportErrors;
+
+#define IMPORT_ERRORS_SHOWN 8
+
+void on_import_error(long line, const char *reason, void *user) {
+    ImportErrors *errors = (ImportErrors*)user;
+    size_t used = strlen(errors->text);
+    if (errors->shown++ < IMPORT_ERRORS_SHOWN) {
+        snprintf(errors->text + used, sizeof(errors->text) - used, "Line %ld: %s\n", line, reason);
+    }
+}
+
+// Adds the rows of a CSV export to the calendar and saves once at the end
+void import_csv_file(HWND hwnd) {
+    char filename[MAX_PATH] = "";
+    OPENFILENAME ofn = {0};
+    ofn.lStructSize = sizeof(OPENFILENAME);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFilter = "CSV Files (*.csv)\0*.csv\0All Files (*.*)\0*.*\0";
+    ofn.lpstrFile = filename;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+    ofn.lpstrDefExt = "csv";
+    if (!GetOpenFileName(&ofn)) return;
+    
+    ImportErrors errors = { "", 0 };
+    ImportResult res;
+    HCURSOR old_cursor = SetCursor(LoadCursor(NULL, IDC_WAIT));
+    DWORD started = GetTickCount();
+    int ok = import_from_csv(filename, &res, on_import_error, &errors);
+    DWORD elapsed = GetTickCount() - started;
+    if (res.imported > 0) {
+        save_events();
+        update_list_view(NULL);
+        refresh_day_states();
+        arm_reminder_timer();
+    }
+    SetCursor(old_cursor);
+    
+    char msg[1000];
+    snprintf(msg, sizeof(msg), "%s\n\nImported %d events in %lu ms (%.0f rows/s).\n"
+             "Rejected lines: %d\n\n%s%s",
+             ok ? "Import complete." : "The file could not be read to the end.",
+             res.imported, (unsigned long)elapsed,
+             elapsed ? res.lines * 1000.0 / elapsed : (double)res.lines,
+             res.rejected, errors.text,
+             errors.shown > IMPORT_ERRORS_SHOWN ? "..." : "");
+    MessageBox(hwnd, msg, "Import CSV", MB_OK | (ok && !res.rejected ? MB_ICONINFORMATION : MB_ICONWARNING));
+    SetWindowText(hwndStatus, res.imported > 0 ? "Events imported!" : "Nothing imported");
+}
+
+// Applies the dialog's repeat settings. Skipped occurrences and an end
+// date set earlier are kept while the event keeps repeating.
+// Rule from the dialog's repeat fields, keeping the skipped dates of the
+// series e (NULL when adding). Returns NULL if the event does not repeat.
+const Recurrence *dialog_rule(Recurrence *rule, const Event *e, int frequency, int every, int times) {
+    *rule = (Recurrence){0};
+    if (e && e->repeat) *rule = *e->repeat;
+    rule->frequency = (RepeatFrequency)frequency;
+    rule->interval = every;
+    rule->count = times;
+    return frequency > REPEAT_NONE ? rule : NULL;
+}
+
+void set_dialog_repeat(Event *e, int frequency, int every, int times) {
+    Recurrence rule;
+    set_event_repeat(e->id, dialog_rule(&rule, e, frequency, every, times));
+}
+
+#define CONFLICTS_SHOWN 5
+// Days of a repeating event's occurrences checked for conflicts on save
+#define CONFLICT_HORIZON_DAYS 366
+
+// Lists the events the one being saved would overlap and asks whether to
+// save anyway
+int confirm_conflicts(HWND hwnd, const int *ids, int count, int repeats) {
+    char msg[1200];
+    int len = snprintf(msg, sizeof(msg), "This event overlaps %d other event%s%s:\n\n",
+                       count, count == 1 ? "" : "s",
+                       repeats ? " within a year of its first date" : "");
+    for (int i = 0; i < count && i < CONFLICTS_SHOWN && len < (int)sizeof(msg) - 1; i++) {
+        char time_str[20];
+        Event *e = find_event_by_id(ids[i]);
+        if (!e) continue;
+        format_event_column(e, 2, time_str, sizeof(time_str));
+        len += snprintf(msg + len, sizeof(msg) - len, "%s  %.80s%s\n", time_str, e->description,
+                        e->repeat ? " (repeats)" : "");
+    }
+    if (count > CONFLICTS_SHOWN && len < (int)sizeof(msg) - 1) {
+        len += snprintf(msg + len, sizeof(msg) - len, "...and %d more\n", count - CONFLICTS_SHOWN);
+    }
+    if (len < (int)sizeof(msg) - 1) snprintf(msg + len, sizeof(msg) - len, "\nSave anyway?");
+    return MessageBox(hwnd, msg, "Time Conflict", MB_YESNO | MB_ICONWARNING) == IDYES;
+}
+
 // Add/Edit Event Dialog
 LRESULT CALLBACK AddEventDlgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
@@ -522,6 +763,14 @@ LRESULT CALLBACK AddEventDlgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
                         EnableWindow(GetDlgItem(hwnd, IDC_REMINDER_MIN), TRUE);
                     }
                     
+                    if (e->repeat) {
+                        SendDlgItemMessage(hwnd, IDC_REPEAT, CB_SETCURSEL, e->repeat->frequency, 0);
+                        SetDlgItemInt(hwnd, IDC_REPEAT_EVERY, e->repeat->interval, FALSE);
+                        SetDlgItemInt(hwnd, IDC_REPEAT_COUNT, e->repeat->count, FALSE);
+                        EnableWindow(GetDlgItem(hwnd, IDC_REPEAT_EVERY), TRUE);
+                        EnableWindow(GetDlgItem(hwnd, IDC_REPEAT_COUNT), TRUE);
+                    }
+                    
                     if (e->is_all_day) {
                         EnableWindow(GetDlgItem(hwnd, IDC_HOUR), FALSE);
                         EnableWindow(GetDlgItem(hwnd, IDC_MIN), FALSE);
@@ -550,12 +799,17 @@ LRESULT CALLBACK AddEventDlgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
                     return 0;
                 }
                 
+                case IDC_REPEAT: {
+                    if (HIWORD(wParam) == CBN_SELCHANGE) {
+                        BOOL repeats = SendDlgItemMessage(hwnd, IDC_REPEAT, CB_GETCURSEL, 0, 0) > REPEAT_NONE;
+                        EnableWindow(GetDlgItem(hwnd, IDC_REPEAT_EVERY), repeats);
+                        EnableWindow(GetDlgItem(hwnd, IDC_REPEAT_COUNT), repeats);
+                    }
+                    return 0;
+                }
+                
                 case IDC_SAVE: {
-                    char desc[MAX_DESC], loc[MAX_LOC];
-                    GetDlgItemText(hwnd, IDC_DESC, desc, MAX_DESC);
-                    GetDlgItemText(hwnd, IDC_LOC, loc, MAX_LOC);
-                    
-                    if (strlen(desc) == 0) {
+                    if (GetWindowTextLength(GetDlgItem(hwnd, IDC_DESC)) == 0) {
                         MessageBox(hwnd, "Description cannot be empty!", "Error", MB_OK | MB_ICONERROR);
                         return 0;
                     }
@@ -581,6 +835,26 @@ LRESULT CALLBACK AddEventDlgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
                         return 0;
                     }
                     
+                    int frequency = (int)SendDlgItemMessage(hwnd, IDC_REPEAT, CB_GETCURSEL, 0, 0);
+                    int every = GetDlgItemInt(hwnd, IDC_REPEAT_EVERY, NULL, FALSE);
+                    int times = GetDlgItemInt(hwnd, IDC_REPEAT_COUNT, NULL, FALSE);
+                    if (frequency > REPEAT_NONE &&
+                        (every < 1 || every > 1000 || times < 0 || times > MAX_REPEAT_COUNT)) {
+                        MessageBox(hwnd, "Invalid repeat! Every: 1-1000, Times: 0-100000", "Error", MB_OK | MB_ICONERROR);
+                        return 0;
+                    }
+                    
+                    // The interval tree answers this without scanning the list;
+                    // a repeating event is checked over its first year
+                    Recurrence rule;
+                    const Recurrence *repeat = dialog_rule(&rule, g_edit_mode ? find_event_by_id(g_edit_event_id) : NULL,
+                                                           frequency, every, times);
+                    int clash_ids[CONFLICTS_SHOWN];
+                    int clashes = find_series_overlaps(g_selected_date, start, end, all_day, repeat,
+                                                       CONFLICT_HORIZON_DAYS, g_edit_mode ? g_edit_event_id : 0,
+                                                       clash_ids, CONFLICTS_SHOWN);
+                    if (clashes > 0 && !confirm_conflicts(hwnd, clash_ids, clashes, repeat != NULL)) return 0;
+                    
                     Priority pri = (Priority)SendDlgItemMessage(hwnd, IDC_PRIORITY, CB_GETCURSEL, 0, 0);
                     Category cat = (Category)SendDlgItemMessage(hwnd, IDC_CATEGORY, CB_GETCURSEL, 0, 0);
                     
@@ -589,36 +863,37 @@ LRESULT CALLBACK AddEventDlgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
                         reminder = GetDlgItemInt(hwnd, IDC_REMINDER_MIN, NULL, FALSE);
                     }
                     
+                    char *desc = get_dlg_item_text_alloc(hwnd, IDC_DESC);
+                    char *loc = get_dlg_item_text_alloc(hwnd, IDC_LOC);
+                    if (!desc || !loc) {
+                        free(desc);
+                        free(loc);
+                        MessageBox(hwnd, "Out of memory!", "Error", MB_OK | MB_ICONERROR);
+                        return 0;
+                    }
+                    
                     if (g_edit_mode) {
                         // Edit existing event
-                        Event *e = find_event_by_id(g_edit_event_id);
+                        Event *e = update_event(g_edit_event_id, g_selected_date, start, end,
+                                                desc, loc, pri, cat, all_day, reminder);
                         if (e) {
-                            e->date = g_selected_date;
-                            e->start_time = start;
-                            e->end_time = end;
-                            strncpy(e->description, desc, MAX_DESC-1);
-                            e->description[MAX_DESC-1] = '\0';
-                            strncpy(e->location, loc, MAX_LOC-1);
-                            e->location[MAX_LOC-1] = '\0';
-                            e->priority = pri;
-                            e->category = cat;
-                            e->is_all_day = all_day;
-                            e->reminder_minutes = reminder;
-                            
-                            save_events();
+                            set_dialog_repeat(e, frequency, every, times);
+                            persist_edit(journal_put(e));
                             update_list_view(NULL);
                             SetWindowText(hwndStatus, "Event updated successfully!");
                         }
                     } else {
                         // Create new event 
-                        Event *e = create_event(g_selected_date, start, end, desc, loc, pri, cat, all_day, reminder);
+                        Event *e = add_event(g_selected_date, start, end, desc, loc, pri, cat, all_day, reminder);
                         if (e) {
-                            add_event_to_list(e);
-                            save_events();
+                            set_dialog_repeat(e, frequency, every, times);
+                            persist_edit(journal_put(e));
                             update_list_view(NULL);
                             SetWindowText(hwndStatus, "Event added successfully!");
                         }
                     }
+                    free(desc);
+                    free(loc);
                     
                     DestroyWindow(hwnd);
                     hwndAddDialog = NULL;
@@ -767,6 +1042,30 @@ void show_add_edit_event_dialog(HWND parent, int edit_mode, int event_id) {
     EnableWindow(hwndReminderMin, FALSE);
     CreateWindow("STATIC", "minutes before", WS_CHILD | WS_VISIBLE,
                 210, y+3, 100, 20, hwndAddDialog, NULL, hInst, NULL);
+    y += 35;
+    
+    CreateWindow("STATIC", "Repeat:", WS_CHILD | WS_VISIBLE,
+                15, y+3, 60, 20, hwndAddDialog, NULL, hInst, NULL);
+    HWND hwndRepeat = CreateWindow("COMBOBOX", "", WS_CHILD | WS_VISIBLE | CBS_DROPDOWNLIST | WS_TABSTOP,
+                                   75, y, 90, 200, hwndAddDialog, (HMENU)IDC_REPEAT, hInst, NULL);
+    SendMessage(hwndRepeat, CB_ADDSTRING, 0, (LPARAM)"Never");
+    SendMessage(hwndRepeat, CB_ADDSTRING, 0, (LPARAM)"Daily");
+    SendMessage(hwndRepeat, CB_ADDSTRING, 0, (LPARAM)"Weekly");
+    SendMessage(hwndRepeat, CB_ADDSTRING, 0, (LPARAM)"Monthly");
+    SendMessage(hwndRepeat, CB_ADDSTRING, 0, (LPARAM)"Yearly");
+    SendMessage(hwndRepeat, CB_SETCURSEL, REPEAT_NONE, 0);
+    CreateWindow("STATIC", "every", WS_CHILD | WS_VISIBLE,
+                175, y+3, 35, 20, hwndAddDialog, NULL, hInst, NULL);
+    HWND hwndRepeatEvery = CreateWindowEx(WS_EX_CLIENTEDGE, "EDIT", "1",
+                                          WS_CHILD | WS_VISIBLE | WS_BORDER | WS_TABSTOP | ES_NUMBER,
+                                          210, y, 40, 25, hwndAddDialog, (HMENU)IDC_REPEAT_EVERY, hInst, NULL);
+    CreateWindow("STATIC", "times (0 = forever):", WS_CHILD | WS_VISIBLE,
+                260, y+3, 120, 20, hwndAddDialog, NULL, hInst, NULL);
+    HWND hwndRepeatCount = CreateWindowEx(WS_EX_CLIENTEDGE, "EDIT", "0",
+                                          WS_CHILD | WS_VISIBLE | WS_BORDER | WS_TABSTOP | ES_NUMBER,
+                                          385, y, 60, 25, hwndAddDialog, (HMENU)IDC_REPEAT_COUNT, hInst, NULL);
+    EnableWindow(hwndRepeatEvery, FALSE);
+    EnableWindow(hwndRepeatCount, FALSE);
     y += 50;
     
     CreateWindow("BUTTON", edit_mode ? "Update Event" : "Save Event", 
@@ -782,6 +1081,169 @@ void show_add_edit_event_dialog(HWND parent, int edit_mode, int event_id) {
     }
 }
 
+// Find Slot dialog: searches forward from now and books the picked gap
+LRESULT CALLBACK FindSlotDlgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+        case WM_COMMAND: {
+            switch (LOWORD(wParam)) {
+                case IDC_SLOT_FIND: {
+                    SlotQuery q = {0};
+                    int days = GetDlgItemInt(hwnd, IDC_SLOT_DAYS, NULL, FALSE);
+                    get_today(&q.from);
+                    q.to = days_to_date(date_to_days(q.from) + (days > 0 ? days : 1) - 1);
+                    q.day_start.hour = GetDlgItemInt(hwnd, IDC_SLOT_FROM, NULL, FALSE);
+                    q.day_end.hour = GetDlgItemInt(hwnd, IDC_SLOT_TO, NULL, FALSE);
+                    q.minutes = GetDlgItemInt(hwnd, IDC_SLOT_MINUTES, NULL, FALSE);
+                    q.not_before = local_minute_now();
+                    if (IsDlgButtonChecked(hwnd, IDC_SLOT_WEEKDAYS)) q.weekdays = 0x1F;
+                    if (IsDlgButtonChecked(hwnd, IDC_SLOT_REMINDERS)) q.ignore_categories = 1u << CAT_REMINDER;
+                    
+                    SendDlgItemMessage(hwnd, IDC_SLOT_LIST, LB_RESETCONTENT, 0, 0);
+                    g_slot_minutes = q.minutes;
+                    g_slot_count = find_free_slots(&q, g_slots, SLOTS_SHOWN);
+                    if (g_slot_count < 0) {
+                        g_slot_count = 0;
+                        MessageBox(hwnd, "Enter a duration that fits between the start and end hours (0-24).",
+                                   "Find Slot", MB_OK | MB_ICONWARNING);
+                        return 0;
+                    }
+                    for (int i = 0; i < g_slot_count; i++) {
+                        const FreeSlot *s = &g_slots[i];
+                        char line[64];
+                        snprintf(line, sizeof(line), "%.3s %02d/%02d/%d  %02d:%02d - %02d:%02d",
+                                 "MonTueWedThuFriSatSun" + day_of_week(s->date) * 3,
+                                 s->date.day, s->date.month, s->date.year,
+                                 s->start.hour, s->start.minute, s->end.hour, s->end.minute);
+                        SendDlgItemMessage(hwnd, IDC_SLOT_LIST, LB_ADDSTRING, 0, (LPARAM)line);
+                    }
+                    if (g_slot_count == 0) {
+                        SendDlgItemMessage(hwnd, IDC_SLOT_LIST, LB_ADDSTRING, 0, (LPARAM)"No free slot found");
+                    } else {
+                        SendDlgItemMessage(hwnd, IDC_SLOT_LIST, LB_SETCURSEL, 0, 0);
+                    }
+                    return 0;
+                }
+                
+                case IDC_SLOT_LIST:
+                    if (HIWORD(wParam) != LBN_DBLCLK) break;
+                    // fall through
+                case IDC_SLOT_BOOK: {
+                    int i = (int)SendDlgItemMessage(hwnd, IDC_SLOT_LIST, LB_GETCURSEL, 0, 0);
+                    if (i < 0 || i >= g_slot_count) return 0;
+                    if (hwndAddDialog) {
+                        SetForegroundWindow(hwndAddDialog);
+                        return 0;
+                    }
+                    // Book the start of the gap for the requested duration
+                    FreeSlot s = g_slots[i];
+                    int end = s.start.hour * 60 + s.start.minute + g_slot_minutes;
+                    show_date_range(s.date, s.date, "Free slot on");
+                    show_add_edit_event_dialog(hwndMain, 0, 0);
+                    SetDlgItemInt(hwndAddDialog, IDC_HOUR, s.start.hour, FALSE);
+                    SetDlgItemInt(hwndAddDialog, IDC_MIN, s.start.minute, FALSE);
+                    SetDlgItemInt(hwndAddDialog, IDC_END_HOUR, end / 60 < 24 ? end / 60 : 23, FALSE);
+                    SetDlgItemInt(hwndAddDialog, IDC_END_MIN, end / 60 < 24 ? end % 60 : 59, FALSE);
+                    DestroyWindow(hwnd);
+                    hwndSlotDialog = NULL;
+                    return 0;
+                }
+                
+                case IDC_CANCEL: {
+                    DestroyWindow(hwnd);
+                    hwndSlotDialog = NULL;
+                    return 0;
+                }
+            }
+            break;
+        }
+        
+        case WM_CLOSE: {
+            DestroyWindow(hwnd);
+            hwndSlotDialog = NULL;
+            return 0;
+        }
+    }
+    
+    return DefWindowProc(hwnd, msg, wParam, lParam);
+}
+
+void show_find_slot_dialog(HWND parent) {
+    if (hwndSlotDialog) {
+        SetForegroundWindow(hwndSlotDialog);
+        return;
+    }
+    
+    static int registered = 0;
+    if (!registered) {
+        WNDCLASSEX wc = {0};
+        wc.cbSize = sizeof(WNDCLASSEX);
+        wc.lpfnWndProc = FindSlotDlgProc;
+        wc.hInstance = hInst;
+        wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+        wc.hbrBackground = (HBRUSH)(COLOR_BTNFACE + 1);
+        wc.lpszClassName = "FindSlotDialog";
+        RegisterClassEx(&wc);
+        registered = 1;
+    }
+    
+    g_slot_count = 0;
+    hwndSlotDialog = CreateWindowEx(
+        WS_EX_DLGMODALFRAME | WS_EX_TOPMOST,
+        "FindSlotDialog",
+        "Find Free Slot",
+        WS_POPUP | WS_CAPTION | WS_SYSMENU | WS_VISIBLE,
+        CW_USEDEFAULT, CW_USEDEFAULT, 400, 460,
+        parent, NULL, hInst, NULL
+    );
+    
+    int y = 15;
+    
+    CreateWindow("STATIC", "Duration (minutes):", WS_CHILD | WS_VISIBLE,
+                15, y+3, 130, 20, hwndSlotDialog, NULL, hInst, NULL);
+    CreateWindowEx(WS_EX_CLIENTEDGE, "EDIT", "45", WS_CHILD | WS_VISIBLE | WS_BORDER | WS_TABSTOP | ES_NUMBER,
+                  150, y, 50, 25, hwndSlotDialog, (HMENU)IDC_SLOT_MINUTES, hInst, NULL);
+    y += 35;
+    
+    CreateWindow("STATIC", "Between hours:", WS_CHILD | WS_VISIBLE,
+                15, y+3, 130, 20, hwndSlotDialog, NULL, hInst, NULL);
+    CreateWindowEx(WS_EX_CLIENTEDGE, "EDIT", "9", WS_CHILD | WS_VISIBLE | WS_BORDER | WS_TABSTOP | ES_NUMBER,
+                  150, y, 50, 25, hwndSlotDialog, (HMENU)IDC_SLOT_FROM, hInst, NULL);
+    CreateWindow("STATIC", "and", WS_CHILD | WS_VISIBLE,
+                210, y+3, 30, 20, hwndSlotDialog, NULL, hInst, NULL);
+    CreateWindowEx(WS_EX_CLIENTEDGE, "EDIT", "18", WS_CHILD | WS_VISIBLE | WS_BORDER | WS_TABSTOP | ES_NUMBER,
+                  245, y, 50, 25, hwndSlotDialog, (HMENU)IDC_SLOT_TO, hInst, NULL);
+    y += 35;
+    
+    CreateWindow("STATIC", "Within the next (days):", WS_CHILD | WS_VISIBLE,
+                15, y+3, 130, 20, hwndSlotDialog, NULL, hInst, NULL);
+    CreateWindowEx(WS_EX_CLIENTEDGE, "EDIT", "14", WS_CHILD | WS_VISIBLE | WS_BORDER | WS_TABSTOP | ES_NUMBER,
+                  150, y, 50, 25, hwndSlotDialog, (HMENU)IDC_SLOT_DAYS, hInst, NULL);
+    y += 35;
+    
+    CreateWindow("BUTTON", "Weekdays only", WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX | WS_TABSTOP,
+                15, y, 130, 25, hwndSlotDialog, (HMENU)IDC_SLOT_WEEKDAYS, hInst, NULL);
+    CreateWindow("BUTTON", "Reminders don't block", WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX | WS_TABSTOP,
+                150, y, 180, 25, hwndSlotDialog, (HMENU)IDC_SLOT_REMINDERS, hInst, NULL);
+    CheckDlgButton(hwndSlotDialog, IDC_SLOT_WEEKDAYS, BST_CHECKED);
+    CheckDlgButton(hwndSlotDialog, IDC_SLOT_REMINDERS, BST_CHECKED);
+    y += 35;
+    
+    CreateWindow("BUTTON", "Find", WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON | WS_TABSTOP,
+                15, y, 100, 30, hwndSlotDialog, (HMENU)IDC_SLOT_FIND, hInst, NULL);
+    y += 40;
+    
+    CreateWindowEx(WS_EX_CLIENTEDGE, "LISTBOX", "", WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_TABSTOP | LBS_NOTIFY,
+                  15, y, 355, 170, hwndSlotDialog, (HMENU)IDC_SLOT_LIST, hInst, NULL);
+    y += 180;
+    
+    CreateWindow("BUTTON", "Book Slot", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
+                80, y, 110, 35, hwndSlotDialog, (HMENU)IDC_SLOT_BOOK, hInst, NULL);
+    CreateWindow("BUTTON", "Close", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
+                200, y, 110, 35, hwndSlotDialog, (HMENU)IDC_CANCEL, hInst, NULL);
+    
+    SetFocus(GetDlgItem(hwndSlotDialog, IDC_SLOT_MINUTES));
+}
+
 // Main Window Procedure
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
@@ -839,7 +1301,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             SendMessage(hwndFilterPri, CB_SETCURSEL, 0, 0);
             // List View
             hwndListView = CreateWindowEx(WS_EX_CLIENTEDGE, WC_LISTVIEW, "",
-                                         WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SINGLESEL,
+                                         WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SINGLESEL | LVS_OWNERDATA,
                                          340, 60, 850, 480,
                                          hwnd, (HMENU)ID_LIST, hInst, NULL);
             
@@ -877,6 +1339,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
             ListView_SetExtendedListViewStyle(hwndListView, 
                 LVS_EX_FULLROWSELECT | LVS_EX_GRIDLINES);
+            update_sort_arrows();
             
             // Buttons 
             int btn_y = 340;
@@ -900,11 +1363,22 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             
             btn_y += btn_h + btn_spacing;
             
-            CreateWindow("BUTTON", "View Today", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
-                        20, btn_y, btn_w, btn_h, hwnd, (HMENU)ID_VIEW_TODAY, hInst, NULL);
+            // View row: five narrow buttons across the two columns
+            int view_w = (btn_w * 2 + btn_spacing - 4 * 5) / 5;
+            CreateWindow("BUTTON", "Today", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
+                        20, btn_y, view_w, btn_h, hwnd, (HMENU)ID_VIEW_TODAY, hInst, NULL);
+            
+            CreateWindow("BUTTON", "Week", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
+                        20 + (view_w + 5), btn_y, view_w, btn_h, hwnd, (HMENU)ID_VIEW_WEEK, hInst, NULL);
             
-            CreateWindow("BUTTON", "View All", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
-                        170, btn_y, btn_w, btn_h, hwnd, (HMENU)ID_VIEW_ALL, hInst, NULL);
+            CreateWindow("BUTTON", "Month", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
+                        20 + (view_w + 5) * 2, btn_y, view_w, btn_h, hwnd, (HMENU)ID_VIEW_MONTH, hInst, NULL);
+            
+            CreateWindow("BUTTON", "Agenda", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
+                        20 + (view_w + 5) * 3, btn_y, view_w, btn_h, hwnd, (HMENU)ID_VIEW_AGENDA, hInst, NULL);
+            
+            CreateWindow("BUTTON", "All", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
+                        20 + (view_w + 5) * 4, btn_y, view_w, btn_h, hwnd, (HMENU)ID_VIEW_ALL, hInst, NULL);
             
             btn_y += btn_h + btn_spacing;
             
@@ -916,11 +1390,20 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             
             btn_y += btn_h + btn_spacing;
             
+            CreateWindow("BUTTON", "Import CSV", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
+                        20, btn_y, btn_w, btn_h, hwnd, (HMENU)ID_IMPORT, hInst, NULL);
+            
             CreateWindow("BUTTON", "Statistics", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
-                        20, btn_y, (btn_w * 2) + btn_spacing, btn_h, hwnd, (HMENU)ID_STATS, hInst, NULL);
+                        170, btn_y, btn_w, btn_h, hwnd, (HMENU)ID_STATS, hInst, NULL);
 
+            CreateWindow("BUTTON", "Find Slot", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
+                        20, btn_y + 50, (btn_w - 5) * 2 / 3, 35, hwnd, (HMENU)ID_FIND_SLOT, hInst, NULL);
+            
             CreateWindow("BUTTON", "Debug", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP,
-                        20, btn_y + 50, 290, 35, hwnd, (HMENU)9999, hInst, NULL);
+                        20 + (btn_w - 5) * 2 / 3 + 5, btn_y + 50, (btn_w - 5) / 3, 35, hwnd, (HMENU)9999, hInst, NULL);
+            
+            CreateWindow("BUTTON", "Category colors", WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX | WS_TABSTOP,
+                        170, btn_y + 57, btn_w, 20, hwnd, (HMENU)ID_BLEND_CATEGORY, hInst, NULL);
             
             // Status bar
             hwndStatus = CreateWindowEx(0, STATUSCLASSNAME, "Ready",
@@ -929,14 +1412,11 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             
 
             load_events();
+            // From here on saves and backups are written off the UI thread
+            start_persist_worker(on_persist_done, hwnd);
             
             // Debug output
-            int count = 0;
-            Event *e = event_list;
-            while (e) {
-                if (!e->deleted) count++;
-                e = e->next;
-            }
+            int count = count_events();
             
             char status[200];
             sprintf(status, "Loaded %d events. Ready.", count);
@@ -944,6 +1424,10 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             
             // NOW update the list view
             update_list_view(NULL);
+            refresh_day_states();
+            
+            g_reminder_timer = CreateWaitableTimer(NULL, FALSE, NULL);
+            arm_reminder_timer();
             
             return 0;
         }
@@ -969,6 +1453,16 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 return 0;
             }
             
+            // Calendar asks which days to bold for the months it shows
+            if (nmhdr->idFrom == ID_CALENDAR && nmhdr->code == MCN_GETDAYSTATE) {
+                LPNMDAYSTATE pds = (LPNMDAYSTATE)lParam;
+                MONTHDAYSTATE *states = get_day_states(pds->stStart, pds->cDayState);
+                if (states) {
+                    pds->prgDayState = states;
+                }
+                return 0;
+            }
+            
             // Double-click calendar to add event
             if (nmhdr->idFrom == ID_CALENDAR && nmhdr->code == NM_DBLCLK) {
                 show_add_edit_event_dialog(hwnd, 0, 0);
@@ -977,19 +1471,38 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             
             // Double-click list to view details
             if (nmhdr->idFrom == ID_LIST && nmhdr->code == NM_DBLCLK) {
-                int idx = ListView_GetNextItem(hwndListView, -1, LVNI_SELECTED);
-                if (idx != -1) {
-                    LVITEM lvi = {0};
-                    lvi.mask = LVIF_PARAM;
-                    lvi.iItem = idx;
-                    ListView_GetItem(hwndListView, &lvi);
-                    show_event_details((int)lvi.lParam);
+                int id = get_selected_event_id();
+                if (id) {
+                    show_event_details(id);
                 }
                 return 0;
             }
             
-            // Column sorting
+            // Owner-data list: supply cell text on demand
+            if (nmhdr->idFrom == ID_LIST && nmhdr->code == LVN_GETDISPINFO) {
+                NMLVDISPINFO *di = (NMLVDISPINFO*)lParam;
+                if (di->item.mask & LVIF_TEXT) {
+                    Event *e = get_row_event(di->item.iItem);
+                    if (e) {
+                        format_event_column(e, di->item.iSubItem, di->item.pszText, di->item.cchTextMax);
+                    } else if (di->item.cchTextMax > 0) {
+                        di->item.pszText[0] = '\0';
+                    }
+                }
+                return 0;
+            }
+            
+            // Column sorting: clicking the sorted column flips the direction
             if (nmhdr->idFrom == ID_LIST && nmhdr->code == LVN_COLUMNCLICK) {
+                LPNMLISTVIEW pnmv = (LPNMLISTVIEW)lParam;
+                if (pnmv->iSubItem < 0 || pnmv->iSubItem >= SORT_COLUMNS) return 0;
+                if ((SortColumn)pnmv->iSubItem == g_sort_column) {
+                    g_sort_descending = !g_sort_descending;
+                } else {
+                    g_sort_column = (SortColumn)pnmv->iSubItem;
+                    g_sort_descending = 0;
+                }
+                update_sort_arrows();
                 update_list_view(NULL);
                 return 0;
             }
@@ -1003,19 +1516,20 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                         return CDRF_NOTIFYITEMDRAW;
                         
                     case CDDS_ITEMPREPAINT: {
-                        // Get the event ID from lParam
-                        LVITEM lvi = {0};
-                        lvi.mask = LVIF_PARAM;
-                        lvi.iItem = (int)lplvcd->nmcd.dwItemSpec;
-                        ListView_GetItem(hwndListView, &lvi);
-                        
-                        int event_id = (int)lvi.lParam;
-                        Event *e = find_event_by_id(event_id);
-                        
-                        if (e) {
-                            // Set background color based on priority
-                            lplvcd->clrTextBk = get_priority_color(e->priority);
-                            lplvcd->clrText = RGB(0, 0, 0); 
+                        // Background by priority, optionally mixed with the
+                        // category, straight from the resolved rows
+                        int row = (int)lplvcd->nmcd.dwItemSpec;
+                        if (row >= 0 && row < g_view_count && g_view_rows_version == store_version()) {
+                            if (g_view_rows[row].event) {
+                                lplvcd->clrTextBk = g_view_rows[row].color;
+                                lplvcd->clrText = RGB(0, 0, 0);
+                            }
+                        } else {
+                            Event *e = get_row_event(row);
+                            if (e) {
+                                lplvcd->clrTextBk = get_row_color(e);
+                                lplvcd->clrText = RGB(0, 0, 0);
+                            }
                         }
                         
                         return CDRF_NEWFONT;
@@ -1039,13 +1553,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 
                 case ID_EDIT_BTN:
                 case IDM_EDIT: {
-                    int idx = ListView_GetNextItem(hwndListView, -1, LVNI_SELECTED);
-                    if (idx != -1) {
-                        LVITEM lvi = {0};
-                        lvi.mask = LVIF_PARAM;
-                        lvi.iItem = idx;
-                        ListView_GetItem(hwndListView, &lvi);
-                        show_add_edit_event_dialog(hwnd, 1, (int)lvi.lParam);
+                    int id = get_selected_event_id();
+                    if (id) {
+                        show_add_edit_event_dialog(hwnd, 1, id);
                     } else {
                         MessageBox(hwnd, "Please select an event to edit.", 
                                  "No Selection", MB_OK | MB_ICONINFORMATION);
@@ -1055,25 +1565,40 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 
                 case ID_DELETE_BTN:
                 case IDM_DELETE: {
-                    int idx = ListView_GetNextItem(hwndListView, -1, LVNI_SELECTED);
-                    if (idx != -1) {
-                        LVITEM lvi = {0};
-                        lvi.mask = LVIF_PARAM;
-                        lvi.iItem = idx;
-                        ListView_GetItem(hwndListView, &lvi);
-                        
-                        int id = (int)lvi.lParam;
+                    int id = get_selected_event_id();
+                    if (id) {
                         Event *e = find_event_by_id(id);
                         
-                        if (e) {
+                        if (e && e->repeat) {
+                            // Yes drops the occurrence on the row, No the series
+                            char msg[400];
+                            Date d = row_date(e);
+                            snprintf(msg, sizeof(msg), "%s repeats.\n\n"
+                                   "Yes: skip only the occurrence on %02d/%02d/%d\n"
+                                   "No: delete every occurrence",
+                                   e->description, d.day, d.month, d.year);
+                            
+                            int answer = MessageBox(hwnd, msg, "Delete Repeating Event",
+                                                    MB_YESNOCANCEL | MB_ICONQUESTION);
+                            if (answer == IDYES && skip_occurrence(id, d)) {
+                                persist_edit(journal_put(e));
+                                update_list_view(NULL);
+                                SetWindowText(hwndStatus, "Occurrence skipped!");
+                            } else if (answer == IDNO) {
+                                delete_event(id);
+                                persist_edit(journal_delete(id));
+                                update_list_view(NULL);
+                                SetWindowText(hwndStatus, "Event deleted!");
+                            }
+                        } else if (e) {
                             char msg[400];
-                            sprintf(msg, "Delete this event?\n\n%s\n%02d/%02d/%d",
+                            snprintf(msg, sizeof(msg), "Delete this event?\n\n%s\n%02d/%02d/%d",
                                    e->description, e->date.day, e->date.month, e->date.year);
                             
                             if (MessageBox(hwnd, msg, "Confirm Delete",
                                           MB_YESNO | MB_ICONQUESTION) == IDYES) {
                                 delete_event(id);
-                                save_events();
+                                persist_edit(journal_delete(id));
                                 update_list_view(NULL);
                                 SetWindowText(hwndStatus, "Event deleted!");
                             }
@@ -1086,13 +1611,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 }
                 
                 case ID_VIEW_DETAILS: {
-                    int idx = ListView_GetNextItem(hwndListView, -1, LVNI_SELECTED);
-                    if (idx != -1) {
-                        LVITEM lvi = {0};
-                        lvi.mask = LVIF_PARAM;
-                        lvi.iItem = idx;
-                        ListView_GetItem(hwndListView, &lvi);
-                        show_event_details((int)lvi.lParam);
+                    int id = get_selected_event_id();
+                    if (id) {
+                        show_event_details(id);
                     } else {
                         MessageBox(hwnd, "Please select an event to view details.",
                                  "No Selection", MB_OK | MB_ICONINFORMATION);
@@ -1115,6 +1636,30 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     break;
                 }
                 
+                case ID_VIEW_WEEK: {
+                    // Monday to Sunday around the selected day
+                    Date sel = get_calendar_date();
+                    int first = date_to_days(sel) - day_of_week(sel);
+                    show_date_range(days_to_date(first), days_to_date(first + 6), "Week");
+                    break;
+                }
+                
+                case ID_VIEW_MONTH: {
+                    Date sel = get_calendar_date();
+                    Date from = { 1, sel.month, sel.year };
+                    Date to = { days_in_month(from.month, from.year), from.month, from.year };
+                    show_date_range(from, to, "Month");
+                    break;
+                }
+                
+                case ID_VIEW_AGENDA: {
+                    // The next 30 days starting today
+                    Date today;
+                    get_today(&today);
+                    show_date_range(today, days_to_date(date_to_days(today) + AGENDA_DAYS - 1), "Agenda");
+                    break;
+                }
+                
                 case ID_VIEW_ALL:
                 case IDM_REFRESH: {
                     update_list_view(NULL);
@@ -1124,7 +1669,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 
                 case ID_SEARCH:
                 case IDM_SEARCH: {
-                    GetWindowText(hwndSearchBox, g_search_filter, MAX_DESC);
+                    KillTimer(hwnd, ID_SEARCH_TIMER);
+                    GetWindowText(hwndSearchBox, g_search_filter, MAX_SEARCH);
                     update_list_view(NULL);
                     
                     if (strlen(g_search_filter) > 0) {
@@ -1166,83 +1712,124 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                     ofn.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST;
                     ofn.lpstrDefExt = "csv";
                     
-                    if (GetSaveFileName(&ofn)) {
-                        export_to_csv(filename);
-                        MessageBox(hwnd, "Events exported successfully!", 
-                                 "Export Complete", MB_OK | MB_ICONINFORMATION);
+                    // A filtered list can be exported as shown instead
+                    int answer = IDNO;
+                    if (g_view_count < count_events()) {
+                        char msg[200];
+                        snprintf(msg, sizeof(msg), "Export only the %d events in the current list?\n\n"
+                                 "No exports all %d events.", g_view_count, count_events());
+                        answer = MessageBox(hwnd, msg, "Export CSV", MB_YESNOCANCEL | MB_ICONQUESTION);
+                    }
+                    
+                    if (answer != IDCANCEL && GetSaveFileName(&ofn)) {
+                        int ok = answer == IDYES ? export_events_to_csv(filename, g_view_ids, g_view_count, 0)
+                                                 : export_to_csv(filename);
+                        if (ok) {
+                            MessageBox(hwnd, "Events exported successfully!", 
+                                     "Export Complete", MB_OK | MB_ICONINFORMATION);
+                        } else {
+                            MessageBox(hwnd, "Could not write the CSV file.", "Export Failed", MB_OK | MB_ICONERROR);
+                        }
                     }
                     break;
                 }
                 
+                case ID_IMPORT: {
+                    import_csv_file(hwnd);
+                    break;
+                }
+                
                 case ID_BACKUP: {
                     backup_data();
                     break;
                 }
                 
                 case ID_STATS: {
-                    int total = 0, priorities[4] = {0}, categories[8] = {0};
-                    int all_day = 0, with_reminder = 0; 
-                    Event *e = event_list;
-                    while (e) {
-                        if (!e->deleted) {
-                            total++;
-                            priorities[e->priority]++;
-                            categories[e->category]++;
-                            if (e->is_all_day) all_day++;
-                            if (e->reminder_minutes > 0) with_reminder++;
-                        }
-                        e = e->next;
-                    }
+                    // Every figure is kept current by the store, so this
+                    // does not walk the events
+                    EventStats st;
+                    StoreStats store;
+                    Date today;
+                    int months[12];
+                    get_event_stats(&st);
+                    get_store_stats(&store);
+                    get_today(&today);
+                    month_histogram(today.year, 1, 12, months);
                     
-                    char stats[2000];
-                    sprintf(stats, 
+                    char stats[3000];
+                    int len = snprintf(stats, sizeof(stats),
                            "===================================\n"
                            "        CALENDAR STATISTICS\n"
                            "===================================\n\n"
                            "OVERVIEW:\n"
                            "  Total Events: %d\n"
                            "  All-Day Events: %d\n"
-                           "  Events with Reminders: %d\n\n"
+                           "  Events with Reminders: %d\n"
+                           "  Repeating Events: %d\n\n"
                            "PRIORITY DISTRIBUTION:\n"
                            "  Critical: %d\n"
                            "  High: %d\n"
                            "  Medium: %d\n"
                            "  Low: %d\n\n"
-                           "CATEGORY DISTRIBUTION:\n"
-                           "  Work: %d\n"
-                           "  Personal: %d\n"
-                           "  Birthday: %d\n"
-                           "  Meeting: %d\n"
-                           "  Appointment: %d\n"
-                           "  Reminder: %d\n"
-                           "  Holiday: %d\n"
-                           "  Other: %d\n",
-                           total, all_day, with_reminder,
-                           priorities[PRIORITY_CRITICAL],
-                           priorities[PRIORITY_HIGH],
-                           priorities[PRIORITY_MEDIUM],
-                           priorities[PRIORITY_LOW],
-                           categories[CAT_WORK],
-                           categories[CAT_PERSONAL],
-                           categories[CAT_BIRTHDAY],
-                           categories[CAT_MEETING],
-                           categories[CAT_APPOINTMENT],
-                           categories[CAT_REMINDER],
-                           categories[CAT_HOLIDAY],
-                           categories[CAT_OTHER]);
+                           "CATEGORY DISTRIBUTION (scheduled hours):\n",
+                           st.total, st.all_day, st.with_reminder, st.repeating,
+                           st.priorities[PRIORITY_CRITICAL],
+                           st.priorities[PRIORITY_HIGH],
+                           st.priorities[PRIORITY_MEDIUM],
+                           st.priorities[PRIORITY_LOW]);
+                    for (int c = CAT_WORK; c <= CAT_OTHER; c++) {
+                        len += snprintf(stats + len, sizeof(stats) - len, "  %s: %d (%.1f h)\n",
+                                        category_to_string((Category)c), st.categories[c],
+                                        st.category_minutes[c] / 60.0);
+                    }
+                    
+                    len += snprintf(stats + len, sizeof(stats) - len, "\nBUSIEST DAYS:\n");
+                    for (int i = 0; i < st.busiest_count; i++) {
+                        len += snprintf(stats + len, sizeof(stats) - len, "  %02d/%02d/%d: %d events\n",
+                                        st.busiest[i].date.day, st.busiest[i].date.month,
+                                        st.busiest[i].date.year, st.busiest[i].events);
+                    }
+                    
+                    len += snprintf(stats + len, sizeof(stats) - len, "\n%d BY MONTH:\n", today.year);
+                    for (int m = 0; m < 12; m++) {
+                        len += snprintf(stats + len, sizeof(stats) - len, "  %.3s %d%s",
+                                        "JanFebMarAprMayJunJulAugSepOctNovDec" + m * 3, months[m],
+                                        m % 6 == 5 ? "\n" : "");
+                    }
+                    
+                    snprintf(stats + len, sizeof(stats) - len,
+                           "\nSTORAGE:\n"
+                           "  Live: %d | Deleted: %d | Free slots: %d\n"
+                           "  Arena: %d chunks, %.1f KB used, %.1f KB wasted\n",
+                           store.live, store.dead, store.free_slots,
+                           store.arena_chunks, store.arena_bytes_used / 1024.0,
+                           store.arena_bytes_wasted / 1024.0);
                     
                     MessageBox(hwnd, stats, "Calendar Statistics", MB_OK | MB_ICONINFORMATION);
                     break;
                 }
                 
+                case ID_FIND_SLOT: {
+                    show_find_slot_dialog(hwnd);
+                    break;
+                }
+                
                 case ID_SEARCH_BOX: {
+                    // Restarting the timer on each keystroke coalesces a burst
+                    // of typing into one refresh
                     if (HIWORD(wParam) == EN_CHANGE) {
-                        GetWindowText(hwndSearchBox, g_search_filter, MAX_DESC);
-                        update_list_view(NULL);
+                        SetTimer(hwnd, ID_SEARCH_TIMER, SEARCH_DEBOUNCE_MS, NULL);
                     }
                     break;
                 }
 
+                case ID_BLEND_CATEGORY: {
+                    g_blend_category = IsDlgButtonChecked(hwnd, ID_BLEND_CATEGORY) == BST_CHECKED;
+                    resolve_view_rows();
+                    InvalidateRect(hwndListView, NULL, TRUE);
+                    break;
+                }
+                
                 case 9999: {
                     debug_print_events();
                     update_list_view(NULL);
@@ -1252,6 +1839,15 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return 0;
         }
         
+        case WM_TIMER: {
+            if (wParam == ID_SEARCH_TIMER) {
+                KillTimer(hwnd, ID_SEARCH_TIMER);
+                GetWindowText(hwndSearchBox, g_search_filter, MAX_SEARCH);
+                update_list_view(NULL);
+            }
+            return 0;
+        }
+        
         case WM_SIZE: {
             SendMessage(hwndStatus, WM_SIZE, 0, 0);
             return 0;
@@ -1275,16 +1871,42 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return 0;
         }
         
+        case WM_APP_PERSIST: {
+            int kind = (int)wParam, ok = (int)lParam;
+            if (kind == PERSIST_BACKUP) {
+                char msg[500];
+                if (ok) {
+                    snprintf(msg, sizeof(msg), "Backup created successfully:\n%s", g_backup_file);
+                    MessageBox(hwnd, msg, "Backup Complete", MB_OK | MB_ICONINFORMATION);
+                } else {
+                    snprintf(msg, sizeof(msg), "Could not write backup:\n%s", g_backup_file);
+                    MessageBox(hwnd, msg, "Backup Failed", MB_OK | MB_ICONERROR);
+                }
+                SetWindowText(hwndStatus, "Ready");
+            } else if (!ok && kind == PERSIST_JOURNAL) {
+                // The journal could not be written, try a full save instead
+                SetWindowText(hwndStatus, "Journal write failed, saving all events...");
+                save_events();
+            } else if (!ok) {
+                SetWindowText(hwndStatus, "Save failed! Changes are kept in the journal.");
+            }
+            return 0;
+        }
+        
         case WM_DESTROY: {
+            if (g_reminder_timer) CancelWaitableTimer(g_reminder_timer);
+            
+            // Fold the journal into calendar.dat and wait for the disk
             save_events();
+            stop_persist_worker();
+            stop_scan_workers();
+            close_journal();
             
             // Free memory
-            Event *e = event_list;
-            while (e) {
-                Event *next = e->next;
-                free(e);
-                e = next;
-            }
+            free(g_view_ids);
+            free(g_view_rows);
+            free(g_day_states);
+            free_events();
             
             PostQuitMessage(0);
             return 0;
@@ -1363,25 +1985,29 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     ShowWindow(hwndMain, nCmdShow);
     UpdateWindow(hwndMain);
     
-    // Show welcome message
-    Date today;
-    get_today(&today);
-    
-    int event_count = 0;
-    Event *e = event_list;
-    while (e) {
-        if (!e->deleted) event_count++;
-        e = e->next;
-    }
-    
-    // Message loop with accelerator support
-    MSG msg;
-    while (GetMessage(&msg, NULL, 0, 0) > 0) {
-        if (!TranslateAccelerator(hwndMain, hAccel, &msg)) {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+    // Message loop with accelerator support. It sleeps until a message
+    // arrives or the reminder timer fires.
+    MSG msg = {0};
+    int running = 1;
+    while (running) {
+        DWORD wait = MsgWaitForMultipleObjects(g_reminder_timer ? 1 : 0, &g_reminder_timer,
+                                               FALSE, INFINITE, QS_ALLINPUT);
+        if (g_reminder_timer && wait == WAIT_OBJECT_0) {
+            fire_reminders();
+            continue;
+        }
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                running = 0;
+                break;
+            }
+            if (!TranslateAccelerator(hwndMain, hAccel, &msg)) {
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+            }
         }
     }
     
+    if (g_reminder_timer) CloseHandle(g_reminder_timer);
     return (int)msg.wParam;
 }